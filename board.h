@@ -0,0 +1,644 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <vector>
+#include "merge_rules.h"
+
+// Bounded cache of drop outcomes. A drop is fully determined by the board,
+// the dropped value and the drop column, so the post-autoMerge board, the
+// score delta and any nextNumber override can be reused. Entries are chained
+// per hash bucket and evicted with the CLOCK (second chance) policy.
+//
+// It pays off where positions repeat: a bot resolves a trial drop for every
+// column and then makes one of them for real, and bots playing the same seed
+// share their openings. On that workload (--bench-cache) 4096 entries give a
+// ~46% hit rate and a 1.25-1.4x speedup. One-off random games rarely repeat
+// a position (about 5% hits) and gain nothing from it.
+//
+// Hits replay the result without calling announceBonus, so bonus messages are
+// not shown for cached drops; a console GameBoard should not use a cache.
+class DropCache {
+public:
+    static const int CELLS = BOARD_SIZE * BOARD_SIZE;
+
+    struct Entry {
+        int key[CELLS];
+        int keyValue;
+        int keyCol;
+        int result[CELLS];
+        int scoreDelta;
+        int nextOverride;   // 0 when the drop gave no bonus
+        int bucket;
+        int chain;          // next entry in the same bucket, -1 ends the chain
+        bool referenced;
+    };
+
+private:
+    std::vector<Entry> entries;
+    std::vector<int> buckets;
+    int capacity;
+    int hand;
+    long long hits;
+    long long misses;
+
+    void unlink(int idx) {
+        int* link = &buckets[entries[idx].bucket];
+        while (*link != idx) link = &entries[*link].chain;
+        *link = entries[idx].chain;
+    }
+
+    static bool sameKey(const Entry& e, const int* cells, int value, int col) {
+        if (e.keyValue != value || e.keyCol != col) return false;
+        for (int k = 0; k < CELLS; k++) {
+            if (e.key[k] != cells[k]) return false;
+        }
+        return true;
+    }
+
+public:
+    explicit DropCache(int cap) : capacity(cap < 1 ? 1 : cap), hand(0), hits(0), misses(0) {
+        int n = 1;
+        while (n < capacity * 2) n <<= 1;
+        buckets.assign(n, -1);
+        entries.reserve(capacity);
+    }
+
+    // Cheap hash of the raw cells: independent multiplies by a fixed odd
+    // constant per cell, so the work does not form one long dependency chain.
+    static unsigned long long hashOf(const int* cells, int value, int col) {
+        static const unsigned long long salt[CELLS] = {
+            0x9E3779B97F4A7C15ULL, 0xBF58476D1CE4E5B9ULL, 0x94D049BB133111EBULL, 0xD6E8FEB86659FD93ULL,
+            0xA0761D6478BD642FULL, 0xE7037ED1A0B428DBULL, 0x8EBC6AF09C88C6E3ULL, 0x589965CC75374CC3ULL,
+            0x1D8E4E27C47D124FULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0x85EBCA77C2B2AE63ULL,
+            0x27D4EB2F165667C5ULL, 0xFF51AFD7ED558CCDULL, 0xC4CEB9FE1A85EC53ULL, 0x87C37B91114253D5ULL,
+            0x4CF5AD432745937FULL, 0x52DCE729DA3ED8D1ULL, 0x9FB21C651E98DF25ULL, 0xB492B66FBE98F273ULL,
+            0x9AE16A3B2F90404FULL, 0xCBF29CE484222325ULL, 0x100000001B3ULL | 1, 0xF1357AEA2E62A9C5ULL,
+            0x2545F4914F6CDD1DULL
+        };
+        unsigned long long h = (unsigned long long)value * 0x2127599BF4325C37ULL + (unsigned long long)col;
+        for (int k = 0; k < CELLS; k++) h += (unsigned long long)(unsigned)cells[k] * salt[k];
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 32;
+        return h;
+    }
+
+    const Entry* find(unsigned long long hash, const int* cells, int value, int col) {
+        int b = (int)(hash & (buckets.size() - 1));
+        for (int i = buckets[b]; i != -1; i = entries[i].chain) {
+            Entry& e = entries[i];
+            if (sameKey(e, cells, value, col)) {
+                e.referenced = true;
+                hits++;
+                return &e;
+            }
+        }
+        misses++;
+        return 0;
+    }
+
+    void insert(unsigned long long hash, const int* cells, int value, int col,
+                const int* result, int scoreDelta, int nextOverride) {
+        int idx;
+        if ((int)entries.size() < capacity) {
+            idx = (int)entries.size();
+            entries.push_back(Entry());
+        } else {
+            while (entries[hand].referenced) {
+                entries[hand].referenced = false;
+                hand = (hand + 1) % capacity;
+            }
+            idx = hand;
+            hand = (hand + 1) % capacity;
+            unlink(idx);
+        }
+        Entry& e = entries[idx];
+        for (int k = 0; k < CELLS; k++) {
+            e.key[k] = cells[k];
+            e.result[k] = result[k];
+        }
+        e.keyValue = value;
+        e.keyCol = col;
+        e.scoreDelta = scoreDelta;
+        e.nextOverride = nextOverride;
+        e.bucket = (int)(hash & (buckets.size() - 1));
+        e.chain = buckets[e.bucket];
+        e.referenced = false;
+        buckets[e.bucket] = idx;
+    }
+
+    void clear() {
+        entries.clear();
+        buckets.assign(buckets.size(), -1);
+        hand = 0;
+        hits = misses = 0;
+    }
+
+    long long getHits() const { return hits; }
+    long long getMisses() const { return misses; }
+    int getSize() const { return (int)entries.size(); }
+
+    double hitRate() const {
+        long long total = hits + misses;
+        return total == 0 ? 0.0 : (double)hits / total;
+    }
+};
+
+// Console-free game rules: the board, merging, scoring and the tile RNG.
+// GameBoard adds the Windows console front end on top; the squeezer library
+// steps plain Boards directly.
+class Board {
+public:
+    static const int SIZE = BOARD_SIZE;
+
+protected:
+    int board[SIZE][SIZE];
+    int score;
+    int nextNumber;
+    int launcherNumber;
+    int lastDropCol;
+    unsigned rngState;
+    DropCache* dropCache;
+    const CompiledRuleSet* rules;
+
+    // Called whenever a merge or triangle grants a bonus next number.
+    virtual void announceBonus(const char* kind, int val) {
+        (void)kind;
+        nextNumber = val;
+    }
+
+public:
+    Board() : score(0), nextNumber(2), launcherNumber(2), lastDropCol(-1),
+              rngState(2463534242u), dropCache(0), rules(0) {
+        clearBoard();
+    }
+
+    virtual ~Board() {}
+
+    // Optional, owned by the caller. Pass 0 to resolve every drop directly.
+    void setDropCache(DropCache* cache) { dropCache = cache; }
+
+    // Plays with a compiled rule set instead of the built-in merges and
+    // triangles; 0 goes back to the built-in ones. Cached drops are only
+    // valid for one rule set, so an attached cache is emptied.
+    void setRules(const CompiledRuleSet* ruleSet) {
+        rules = ruleSet;
+        if (dropCache) dropCache->clear();
+    }
+
+    int getScore() const { return score; }
+    int getLauncherNumber() const { return launcherNumber; }
+    int getNextNumber() const { return nextNumber; }
+    int getCell(int row, int col) const { return board[row][col]; }
+    int getLastDropCol() const { return lastDropCol; }
+    unsigned getRandomState() const { return rngState; }
+
+    // Puts back a game captured with the getters above, e.g. from a checkpoint.
+    void restoreState(const int cells[SIZE][SIZE], int savedScore, int launcher,
+                      int next, int lastCol, unsigned rng) {
+        for (int i = 0; i < SIZE; i++)
+            for (int j = 0; j < SIZE; j++)
+                board[i][j] = cells[i][j];
+        score = savedScore;
+        launcherNumber = launcher;
+        nextNumber = next;
+        lastDropCol = lastCol;
+        seedRandom(rng);
+    }
+
+    // A drop into col is legal unless the top cell holds a different number.
+    bool canDrop(int col) const {
+        int topVal = board[0][col];
+        return topVal == 0 || topVal == launcherNumber;
+    }
+
+    void clearBoard() {
+        for (int i = 0; i < SIZE; i++)
+            for (int j = 0; j < SIZE; j++)
+                board[i][j] = 0;
+    }
+
+    bool isGameOver() const {
+        for (int i = 0; i < SIZE; i++)
+            for (int j = 0; j < SIZE; j++)
+                if (board[i][j] == 0)
+                    return false;
+
+        for (int i = 0; i < SIZE; i++)
+            for (int j = 0; j < SIZE - 1; j++)
+                if (board[i][j] == board[i][j + 1])
+                    return false;
+
+        for (int i = 0; i < SIZE - 1; i++)
+            for (int j = 0; j < SIZE; j++)
+                if (board[i][j] == board[i + 1][j])
+                    return false;
+
+        return true;
+    }
+
+    bool checkTShapeMerge(int row, int col, int val) {
+        bool merged = false;
+        if (row > 0 && col > 0 && col < SIZE - 1) {
+            if (board[row-1][col] == val && board[row][col-1] == val && board[row][col+1] == val) {
+                board[row-1][col] = 0;
+                board[row][col-1] = 0;
+                board[row][col+1] = 0;
+                board[row][col] = val * 4;
+                score += val * 4;
+                announceBonus("T-shape merge", val);
+                merged = true;
+            }
+        }
+        if (row < SIZE - 1 && col > 0 && col < SIZE - 1) {
+            if (board[row+1][col] == val && board[row][col-1] == val && board[row][col+1] == val) {
+                board[row+1][col] = 0;
+                board[row][col-1] = 0;
+                board[row][col+1] = 0;
+                board[row][col] = val * 4;
+                score += val * 4;
+                announceBonus("T-shape merge", val);
+                merged = true;
+            }
+        }
+        if (!merged) {
+            if (row < SIZE - 1 && col > 0) {
+                if (board[row][col-1] == val && board[row+1][col] == val) {
+                    board[row][col-1] = 0;
+                    board[row+1][col] = 0;
+                    board[row][col] = val * 4;
+                    score += val * 4;
+                    announceBonus("T-shape merge", val);
+                    return true;
+                }
+            }
+            if (row < SIZE - 1 && col < SIZE - 1) {
+                if (board[row][col+1] == val && board[row+1][col] == val) {
+                    board[row][col+1] = 0;
+                    board[row+1][col] = 0;
+                    board[row][col] = val * 4;
+                    score += val * 4;
+                    announceBonus("T-shape merge", val);
+                    return true;
+                }
+            }
+        }
+        return merged;
+    }
+
+    bool checkSideTopMerge(int row, int col, int val) {
+        if (row > 0 && col > 0) {
+            if (board[row-1][col] == val && board[row][col-1] == val) {
+                board[row-1][col] = 0;
+                board[row][col-1] = 0;
+                board[row][col] = val * 4;
+                score += val * 4;
+                announceBonus("Side-Top merge", val);
+                return true;
+            }
+        }
+        if (row > 0 && col < SIZE - 1) {
+            if (board[row-1][col] == val && board[row][col+1] == val) {
+                board[row-1][col] = 0;
+                board[row][col+1] = 0;
+                board[row][col] = val * 4;
+                score += val * 4;
+                announceBonus("Side-Top merge", val);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool mergeOnce() {
+        bool changed = false;
+
+        // Check for horizontal four
+        for (int i = 0; i < SIZE; i++) {
+            for (int j = 0; j <= SIZE - 4; j++) {
+                int a = board[i][j];
+                int b = board[i][j + 1];
+                int c = board[i][j + 2];
+                int d = board[i][j + 3];
+                if (a != 0 && a == b && b == c && c == d) {
+                    int targetCol = (lastDropCol >= j && lastDropCol <= j + 3) ? lastDropCol : j + 1;
+                    for (int k = j; k <= j + 3; k++) {
+                        if (k != targetCol) board[i][k] = 0;
+                    }
+                    board[i][targetCol] = a * 8;
+                    score += a * 8;
+                    changed = true;
+                }
+            }
+        }
+
+        // Check for vertical four
+        for (int j = 0; j < SIZE; j++) {
+            for (int i = 0; i <= SIZE - 4; i++) {
+                int a = board[i][j];
+                int b = board[i + 1][j];
+                int c = board[i + 2][j];
+                int d = board[i + 3][j];
+                if (a != 0 && a == b && b == c && c == d) {
+                    int targetRow = (lastDropCol >= i && lastDropCol <= i + 3) ? lastDropCol : i + 2;
+                    for (int k = i; k <= i + 3; k++) {
+                        if (k != targetRow) board[k][j] = 0;
+                    }
+                    board[targetRow][j] = a * 8;
+                    score += a * 8;
+                    changed = true;
+                }
+            }
+        }
+
+        // Check for side-top merges
+        for (int i = 0; i < SIZE; i++) {
+            for (int j = 0; j < SIZE; j++) {
+                if (board[i][j] != 0) {
+                    if (checkSideTopMerge(i, j, board[i][j])) {
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // Check for T-shape merges
+        for (int i = 0; i < SIZE; i++) {
+            for (int j = 0; j < SIZE; j++) {
+                if (board[i][j] != 0) {
+                    if (checkTShapeMerge(i, j, board[i][j])) {
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < SIZE; i++) {
+            for (int j = 0; j <= SIZE - 3; j++) {
+                int a = board[i][j];
+                int b = board[i][j + 1];
+                int c = board[i][j + 2];
+                if (a != 0 && a == b && b == c) {
+                    int val = a;
+                    int targetCol = j + 1;
+                    if (lastDropCol >= j && lastDropCol <= j + 2) targetCol = lastDropCol;
+                    board[i][targetCol] = val * 4;
+                    for (int k = j; k <= j + 2; k++) if (k != targetCol) board[i][k] = 0;
+                    score += board[i][targetCol];
+                    changed = true;
+                    announceBonus("Horizontal three merge", val);
+                }
+            }
+        }
+
+        for (int i = 0; i < SIZE; i++) {
+            for (int j = 0; j < SIZE - 1; j++) {
+                if (board[i][j] != 0 && board[i][j] == board[i][j + 1]) {
+                    if (lastDropCol >= 0 && (j == lastDropCol || j + 1 == lastDropCol)) {
+                        int targetCol = (j == lastDropCol) ? j : j + 1;
+                        int otherCol = (targetCol == j) ? j + 1 : j;
+                        board[i][targetCol] *= 2;
+                        score += board[i][targetCol];
+                        board[i][otherCol] = 0;
+                    } else {
+                        board[i][j] *= 2;
+                        score += board[i][j];
+                        board[i][j + 1] = 0;
+                    }
+                    changed = true;
+                }
+            }
+        }
+
+        for (int j = 0; j < SIZE; j++) {
+            for (int i = 0; i <= SIZE - 3; i++) {
+                int a = board[i][j];
+                int b = board[i + 1][j];
+                int c = board[i + 2][j];
+                if (a != 0 && a == b && b == c) {
+                    int val = a;
+                    int targetRow = i + 2;
+                    board[targetRow][j] = val * 4;
+                    for (int k = i; k <= i + 2; k++) if (k != targetRow) board[k][j] = 0;
+                    score += board[targetRow][j];
+                    changed = true;
+                    announceBonus("Vertical three merge", val);
+                }
+            }
+        }
+
+        for (int j = 0; j < SIZE; j++) {
+            for (int i = SIZE - 1; i > 0; i--) {
+                if (board[i][j] != 0 && board[i][j] == board[i - 1][j]) {
+                    board[i][j] *= 2;
+                    score += board[i][j];
+                    board[i - 1][j] = 0;
+                    changed = true;
+                }
+            }
+        }
+
+        return changed;
+    }
+
+    void settle() {
+        for (int col = 0; col < SIZE; col++) {
+            int rowIdx = SIZE - 1;
+            for (int row = SIZE - 1; row >= 0; row--) {
+                if (board[row][col] != 0)
+                    board[rowIdx--][col] = board[row][col];
+            }
+            while (rowIdx >= 0) {
+                board[rowIdx--][col] = 0;
+            }
+        }
+    }
+
+    BoardMasks boardMasks() const {
+        BoardMasks m = { 0, 0, 0 };
+        for (int i = 0; i < SIZE; i++) {
+            for (int j = 0; j < SIZE; j++) {
+                int v = board[i][j];
+                if (v == 0) continue;
+                unsigned bit = 1u << (i * SIZE + j);
+                m.occupied |= bit;
+                if (j < SIZE - 1 && board[i][j + 1] == v) m.sameRight |= bit;
+                if (i < SIZE - 1 && board[i + 1][j] == v) m.sameBelow |= bit;
+            }
+        }
+        return m;
+    }
+
+    // Runs one compiled pass. Connected placements are matched on masks
+    // alone; the board is only read for the rare disconnected shape.
+    bool applyPass(const CompiledPass& pass, BoardMasks& masks) {
+        if (!pass.mayMatch(masks)) return false;
+        int* cells = &board[0][0];
+        const RulePlacement* placements = pass.placements.data();
+        int count = (int)pass.placements.size();
+        bool changed = false;
+        for (int k = 0; k < count; ) {
+            const RulePlacement& p = placements[k];
+            bool match;
+            if (p.connected) {
+                match = (masks.occupied & p.mask) == p.mask &&
+                        (masks.sameRight & p.sameRight) == p.sameRight &&
+                        (masks.sameBelow & p.sameBelow) == p.sameBelow;
+            } else {
+                match = (masks.occupied & p.mask) == p.mask;
+                for (int c = 1; match && c < p.cellCount; c++) {
+                    match = cells[p.cells[c]] == cells[p.cells[0]];
+                }
+            }
+            if (!match) {
+                k++;
+                continue;
+            }
+            const MergeRule& rule = pass.rules[p.rule];
+            int val = cells[p.cells[0]];
+            if (rule.multiplier != 0) {
+                for (int c = 0; c < p.cellCount; c++) cells[p.cells[c]] = 0;
+                cells[p.target[lastDropCol + 1]] = val * rule.multiplier;
+                score += val * rule.multiplier;
+                masks = boardMasks();
+                changed = true;
+            }
+            if (rule.bonus) announceBonus(rule.bonus, val);
+            if (pass.stopAfterFirst) break;
+            k = p.anchorEnd;
+        }
+        return changed;
+    }
+
+    bool applyPasses(const std::vector<CompiledPass>& passes) {
+        BoardMasks masks = boardMasks();
+        bool changed = false;
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (applyPass(passes[i], masks)) changed = true;
+        }
+        return changed;
+    }
+
+    void autoMerge() {
+        bool changed;
+        do {
+            settle();
+            changed = rules ? applyPasses(rules->merges) : mergeOnce();
+            settle();
+        } while (changed);
+    }
+
+    void checkTriangles() {
+        bool bonusGiven = false;
+        for (int i = 0; i < SIZE - 1 && !bonusGiven; i++) {
+            for (int j = 0; j < SIZE - 1 && !bonusGiven; j++) {
+                int val = board[i][j];
+                if (val == 0) continue;
+                if (board[i][j + 1] == val && board[i + 1][j] == val) {
+                    announceBonus("Upper Triangle", val);
+                    bonusGiven = true;
+                }
+                else if (board[i + 1][j] == val && board[i + 1][j + 1] == val) {
+                    announceBonus("Lower Triangle", val);
+                    bonusGiven = true;
+                }
+            }
+        }
+    }
+
+    int lowestEmptyInColumn(int col) {
+        for (int i = SIZE - 1; i >= 0; --i) {
+            if (board[i][col] == 0) return i;
+        }
+        return -1;
+    }
+
+    // Each board owns its xorshift32 stream so boards can be stepped from
+    // several threads and replayed from a seed.
+    void seedRandom(unsigned seed) {
+        rngState = seed != 0 ? seed : 2463534242u;
+    }
+
+    unsigned nextRandom() {
+        rngState ^= rngState << 13;
+        rngState ^= rngState >> 17;
+        rngState ^= rngState << 5;
+        return rngState;
+    }
+
+    int rollRandomTile() {
+        int r = (int)(nextRandom() % 5 + 1);
+        return (1 << r);
+    }
+
+    static int tileExponent(int v) {
+        int e = 0;
+        while (v > 1) { v >>= 1; e++; }
+        return e;
+    }
+
+    // Places value in col (or doubles the top cell of a full column) and
+    // runs autoMerge, going through the drop cache when one is attached.
+    void resolveDrop(int col, int value) {
+        int* cells = &board[0][0];
+        int before[SIZE * SIZE];
+        unsigned long long hash = 0;
+        if (dropCache) {
+            hash = DropCache::hashOf(cells, value, col);
+            const DropCache::Entry* hit = dropCache->find(hash, cells, value, col);
+            if (hit) {
+                for (int k = 0; k < SIZE * SIZE; k++) cells[k] = hit->result[k];
+                score += hit->scoreDelta;
+                if (hit->nextOverride != 0) nextNumber = hit->nextOverride;
+                lastDropCol = col;
+                return;
+            }
+            for (int k = 0; k < SIZE * SIZE; k++) before[k] = cells[k];
+        }
+
+        int scoreBefore = score;
+        int nextBefore = nextNumber;
+        nextNumber = 0;
+        int insertRow = lowestEmptyInColumn(col);
+        if (insertRow != -1) {
+            board[insertRow][col] = value;
+        } else {
+            board[0][col] *= 2;
+            score += board[0][col];
+        }
+        lastDropCol = col;
+        autoMerge();
+        int nextOverride = nextNumber;
+        if (nextNumber == 0) nextNumber = nextBefore;
+
+        if (dropCache) {
+            dropCache->insert(hash, before, value, col, cells, score - scoreBefore, nextOverride);
+        }
+    }
+
+    // Drops the launcher number into col. Returns false when the top cell
+    // holds a different number, which ends the game.
+    bool dropLauncher(int col) {
+        int topVal = board[0][col];
+        if (topVal != 0 && topVal != launcherNumber) {
+            return false;
+        }
+        resolveDrop(col, launcherNumber);
+        launcherNumber = nextNumber;
+        nextNumber = rollRandomTile();
+        if (rules) applyPasses(rules->bonuses);
+        else checkTriangles();
+        return true;
+    }
+
+    void resetGame() {
+        score = 0;
+        clearBoard();
+        launcherNumber = rollRandomTile();
+        nextNumber = rollRandomTile();
+        lastDropCol = -1;
+    }
+
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "board.h"
+
+const int BOT_FEATURES = 4;
+
+const char* const BOT_FEATURE_NAMES[BOT_FEATURES] = {
+    "empty cells", "equal pairs", "max tile in corner", "bumpiness"
+};
+
+// Heuristic features of a board position, in BOT_FEATURE_NAMES order.
+// Bumpiness sums the height differences of neighbouring columns, where a
+// column's height runs from the bottom row to its topmost tile.
+inline void botFeatures(const Board& b, double f[BOT_FEATURES]) {
+    const int n = Board::SIZE;
+    int empty = 0, pairs = 0, maxTile = 0;
+    int height[Board::SIZE] = { 0 };
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            int v = b.getCell(i, j);
+            if (v == 0) {
+                empty++;
+                continue;
+            }
+            if (height[j] == 0) height[j] = n - i;
+            if (v > maxTile) maxTile = v;
+            if (j < n - 1 && b.getCell(i, j + 1) == v) pairs++;
+            if (i < n - 1 && b.getCell(i + 1, j) == v) pairs++;
+        }
+    }
+    bool inCorner = maxTile != 0 &&
+        (b.getCell(0, 0) == maxTile || b.getCell(0, n - 1) == maxTile ||
+         b.getCell(n - 1, 0) == maxTile || b.getCell(n - 1, n - 1) == maxTile);
+    f[0] = empty;
+    f[1] = pairs;
+    f[2] = inCorner ? Board::tileExponent(maxTile) : 0;
+    int bumpiness = 0;
+    for (int j = 0; j < n - 1; j++) bumpiness += abs(height[j] - height[j + 1]);
+    f[3] = bumpiness;
+}
+
+// One-ply greedy bot: tries every legal column on a copy of the board and
+// picks the one with the best score gain plus weighted features. The copy
+// only resolves the drop, so the board's tile RNG is never consumed.
+inline int botChooseColumn(const Board& b, const double weights[BOT_FEATURES]) {
+    int bestCol = 0;
+    double bestValue = 0;
+    bool found = false;
+    for (int col = 0; col < Board::SIZE; col++) {
+        if (!b.canDrop(col)) continue;
+        Board trial = b;
+        trial.resolveDrop(col, trial.getLauncherNumber());
+        double f[BOT_FEATURES];
+        botFeatures(trial, f);
+        double value = trial.getScore() - b.getScore();
+        for (int k = 0; k < BOT_FEATURES; k++) value += weights[k] * f[k];
+        if (!found || value > bestValue) {
+            bestValue = value;
+            bestCol = col;
+            found = true;
+        }
+    }
+    return bestCol;
+}
+
+// Plays one game from seed and returns the final score. Games that reach
+// maxDrops are stopped there.
+inline int playBotGame(const double weights[BOT_FEATURES], uint32_t seed, int maxDrops) {
+    Board b;
+    b.seedRandom(seed);
+    b.resetGame();
+    for (int d = 0; d < maxDrops && !b.isGameOver(); d++) {
+        if (!b.dropLauncher(botChooseColumn(b, weights))) break;
+    }
+    return b.getScore();
+}
+
+#endif
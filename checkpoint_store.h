@@ -0,0 +1,306 @@
+#ifndef CHECKPOINT_STORE_H
+#define CHECKPOINT_STORE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "board.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// One saved game in exactly one cache line. Tiles are stored as exponent + 1
+// (0 for an empty cell); every tile is a power of two so nothing is lost.
+struct CheckpointRecord {
+    uint32_t sequence;   // 0 = never written
+    uint32_t checksum;   // FNV-1a over every byte after this field, plus sequence
+    int32_t score;
+    uint32_t rngState;
+    uint8_t cells[Board::SIZE * Board::SIZE];
+    uint8_t launcherExp;
+    uint8_t nextExp;
+    int8_t lastDropCol;
+    uint8_t reserved[20];
+};
+
+static_assert(sizeof(CheckpointRecord) == 64, "a checkpoint record must fill one cache line");
+
+// Each session slot keeps two records and a save always overwrites the older
+// one, so a save torn by a crash still leaves the previous state readable.
+struct CheckpointSlot {
+    CheckpointRecord copies[2];
+};
+
+// File-backed, memory-mapped array of session slots. Saving is a handful of
+// plain stores into the mapping; flush() (msync) makes it durable and runs
+// automatically every flushEvery saves. Opening an existing store only maps
+// the file, so recovery cost does not depend on how many sessions it holds.
+class CheckpointStore {
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t slotSize;
+        uint8_t reserved[108];
+    };
+
+    static const uint32_t VERSION = 1;
+
+    char* base;
+    size_t mappedSize;
+    int slotCount;
+    int flushEvery;
+    int savesSinceFlush;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+
+    CheckpointSlot* slots() const { return (CheckpointSlot*)(base + sizeof(Header)); }
+
+    bool fileIsOpen() const {
+#ifdef _WIN32
+        return file != INVALID_HANDLE_VALUE;
+#else
+        return fd >= 0;
+#endif
+    }
+
+    bool inRange(int slot) const { return base && slot >= 0 && slot < slotCount; }
+
+    // True for a file created by open() that never got its header: the
+    // process stopped between creating it and writing the magic, so it is
+    // still empty or all zeros and can hold no saves.
+    bool headerNeverWritten() const {
+        if (mappedSize == 0) return true;
+        if (!base) return false;
+        size_t n = mappedSize < sizeof(Header) ? mappedSize : sizeof(Header);
+        for (size_t i = 0; i < n; i++) {
+            if (base[i] != 0) return false;
+        }
+        return true;
+    }
+
+    static uint32_t checksumOf(const CheckpointRecord& r) {
+        const uint8_t* p = (const uint8_t*)&r + 8;
+        uint32_t h = 2166136261u ^ r.sequence;
+        h *= 16777619u;
+        for (size_t i = 8; i < sizeof(CheckpointRecord); i++) {
+            h ^= *p++;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    static bool isValid(const CheckpointRecord& r) {
+        return r.sequence != 0 && r.checksum == checksumOf(r);
+    }
+
+    // Index of the newest intact copy in the slot, or -1.
+    static int newestCopy(const CheckpointSlot& s) {
+        bool a = isValid(s.copies[0]);
+        bool b = isValid(s.copies[1]);
+        if (a && b) return s.copies[1].sequence > s.copies[0].sequence ? 1 : 0;
+        if (a) return 0;
+        if (b) return 1;
+        return -1;
+    }
+
+    static uint8_t encodeTile(int v) {
+        return v == 0 ? 0 : (uint8_t)(Board::tileExponent(v) + 1);
+    }
+
+    static int decodeTile(uint8_t e) {
+        return e == 0 ? 0 : 1 << (e - 1);
+    }
+
+    bool mapFile(const char* path, size_t size, bool create) {
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                           create ? CREATE_NEW : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        if (!create) {
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize)) {
+                CloseHandle(file);
+                file = INVALID_HANDLE_VALUE;
+                return false;
+            }
+            size = (size_t)fileSize.QuadPart;
+        }
+        mappedSize = size;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+                                     (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+        if (!mapping) return false;
+        base = (char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+        fd = ::open(path, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0644);
+        if (fd < 0) return false;
+        if (create) {
+            if (ftruncate(fd, (off_t)size) != 0) return false;
+        } else {
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                ::close(fd);
+                fd = -1;
+                return false;
+            }
+            size = (size_t)st.st_size;
+        }
+        mappedSize = size;
+        void* p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        base = p == MAP_FAILED ? 0 : (char*)p;
+#endif
+        return base != 0;
+    }
+
+public:
+    CheckpointStore() : base(0), mappedSize(0), slotCount(0), flushEvery(64), savesSinceFlush(0) {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#else
+        fd = -1;
+#endif
+    }
+
+    ~CheckpointStore() { close(); }
+
+    // Opens path, creating it with the given number of slots when it does not
+    // exist yet. An existing store keeps the slot count it was created with.
+    // A file whose header was never written is created again; any other file
+    // that is not a store is left alone and open() returns false.
+    bool open(const char* path, int slots) {
+        close();
+        if (mapFile(path, 0, false)) {
+            const Header* h = (const Header*)base;
+            if (mappedSize >= sizeof(Header) && memcmp(h->magic, "NSQCKPT", 8) == 0 &&
+                h->version == VERSION && h->slotSize == sizeof(CheckpointSlot) &&
+                mappedSize >= sizeof(Header) + (size_t)h->slotCount * sizeof(CheckpointSlot)) {
+                slotCount = (int)h->slotCount;
+                return true;
+            }
+        }
+        // An empty file cannot be mapped, so it also lands here with the file
+        // open and a size of 0.
+        if (fileIsOpen()) {
+            bool incomplete = headerNeverWritten();
+            close();
+            if (!incomplete || remove(path) != 0) return false;
+        }
+        close();
+        if (slots <= 0) return false;
+
+        size_t size = sizeof(Header) + (size_t)slots * sizeof(CheckpointSlot);
+        if (!mapFile(path, size, true)) {
+            close();
+            return false;
+        }
+        Header* h = (Header*)base;
+        memcpy(h->magic, "NSQCKPT", 8);
+        h->version = VERSION;
+        h->slotCount = (uint32_t)slots;
+        h->slotSize = sizeof(CheckpointSlot);
+        slotCount = slots;
+        flush();
+        return true;
+    }
+
+    void close() {
+        if (base) flush();
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (base) munmap(base, mappedSize);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        base = 0;
+        mappedSize = 0;
+        slotCount = 0;
+    }
+
+    bool isOpen() const { return base != 0; }
+    int getSlotCount() const { return slotCount; }
+
+    // 0 disables the automatic flush; callers then flush() themselves.
+    void setFlushEvery(int saves) { flushEvery = saves; }
+
+    // Returns false when slot is out of range.
+    bool save(int slot, const Board& b) {
+        if (!inRange(slot)) return false;
+        CheckpointSlot& s = slots()[slot];
+        int newest = newestCopy(s);
+        int target = newest == 0 ? 1 : 0;
+        CheckpointRecord& r = s.copies[target];
+
+        r.sequence = newest < 0 ? 1 : s.copies[newest].sequence + 1;
+        r.score = b.getScore();
+        r.rngState = b.getRandomState();
+        for (int i = 0; i < Board::SIZE; i++)
+            for (int j = 0; j < Board::SIZE; j++)
+                r.cells[i * Board::SIZE + j] = encodeTile(b.getCell(i, j));
+        r.launcherExp = encodeTile(b.getLauncherNumber());
+        r.nextExp = encodeTile(b.getNextNumber());
+        r.lastDropCol = (int8_t)b.getLastDropCol();
+        memset(r.reserved, 0, sizeof(r.reserved));
+        r.checksum = checksumOf(r);
+
+        if (flushEvery > 0 && ++savesSinceFlush >= flushEvery) flush();
+        return true;
+    }
+
+    // Restores the newest intact copy of the slot into b. Returns false when
+    // the slot is empty or out of range.
+    bool load(int slot, Board& b) const {
+        if (!inRange(slot)) return false;
+        const CheckpointSlot& s = slots()[slot];
+        int newest = newestCopy(s);
+        if (newest < 0) return false;
+        const CheckpointRecord& r = s.copies[newest];
+
+        int cells[Board::SIZE][Board::SIZE];
+        for (int i = 0; i < Board::SIZE; i++)
+            for (int j = 0; j < Board::SIZE; j++)
+                cells[i][j] = decodeTile(r.cells[i * Board::SIZE + j]);
+        b.restoreState(cells, r.score, decodeTile(r.launcherExp), decodeTile(r.nextExp),
+                       r.lastDropCol, r.rngState);
+        return true;
+    }
+
+    bool isOccupied(int slot) const {
+        return inRange(slot) && newestCopy(slots()[slot]) >= 0;
+    }
+
+    bool clear(int slot) {
+        if (!inRange(slot)) return false;
+        memset(&slots()[slot], 0, sizeof(CheckpointSlot));
+        if (flushEvery > 0 && ++savesSinceFlush >= flushEvery) flush();
+        return true;
+    }
+
+    bool flush() {
+        savesSinceFlush = 0;
+        if (!base) return false;
+#ifdef _WIN32
+        return FlushViewOfFile(base, mappedSize) && FlushFileBuffers(file);
+#else
+        return msync(base, mappedSize, MS_SYNC) == 0;
+#endif
+    }
+};
+
+#endif
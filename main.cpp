@@ -8,26 +8,45 @@
 #include <windows.h>
 #include <string>
 #include <climits>
+#include <chrono>
+#include <cstdio>
+#include "board.h"
+#include "checkpoint_store.h"
+#include "replay_archive.h"
+#include "tuner.h"
 
 using namespace std;
 
-class GameBoard {
+class GameBoard : public Board {
 private:
-    static const int SIZE = 5;
-    vector<vector<int>> board;
-    int score;
-    int nextNumber;
-    int launcherNumber;
     int selectedColumn;
-    int lastDropCol;
+    CheckpointStore* checkpoints;
+    uint32_t gameSeed;
+    vector<uint8_t> dropHistory;
+    bool recordingReplay;
     HANDLE hConsole;
 
+protected:
+    void announceBonus(const char* kind, int val) {
+        setColor(14);
+        cout << "\nBONUS! " << kind << " of " << val << " found! Next number set to " << val << "!\n";
+        setColor(7);
+        nextNumber = val;
+    }
+
 public:
-    GameBoard() : board(SIZE, vector<int>(SIZE, 0)), score(0), nextNumber(2), 
-                 launcherNumber(2), selectedColumn(0), lastDropCol(-1) {
+    GameBoard() : selectedColumn(0), checkpoints(0), gameSeed(0), recordingReplay(false) {
         hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
     }
 
+    // The game in progress is checkpointed to slot 0 after every drop, so
+    // it can be resumed after quitting or a crash.
+    void setCheckpointStore(CheckpointStore* store) { checkpoints = store; }
+
+    bool hasSavedGame() {
+        return checkpoints && checkpoints->isOccupied(0);
+    }
+
     void setColor(int color) {
         SetConsoleTextAttribute(hConsole, color & 0xFF);
     }
@@ -89,6 +108,31 @@ public:
         file.close();
     }
 
+    // A resumed game is not recorded: the drops made before the restart
+    // are not kept, so it could not be replayed.
+    void saveReplay() {
+        if (!recordingReplay) return;
+        Replay r;
+        r.id = 0;
+        r.date = (int64_t)time(0);
+        r.seed = gameSeed;
+        r.score = score;
+        r.drops = dropHistory;
+        const char* path = "replays.nsr";
+        ReplayArchiveWriter archive;
+        if (!archive.open(path)) {
+            // Unreadable archives are moved aside rather than blocking every
+            // later recording; a file that merely cannot be written is kept.
+            ReplayArchiveReader check;
+            if (check.open(path) || rename(path, "replays.nsr.bad") != 0 || !archive.open(path)) {
+                cout << "Could not save the replay to " << path << "." << endl;
+                return;
+            }
+            cout << path << " was damaged and has been moved to replays.nsr.bad." << endl;
+        }
+        archive.append(r);
+    }
+
     int getHighScore() {
         ifstream file("score_history.txt");
         int highScore = 0, currentScore;
@@ -167,303 +211,6 @@ public:
         cout << endl;
     }
 
-    bool isGameOver() {
-        for (int i = 0; i < SIZE; i++)
-            for (int j = 0; j < SIZE; j++)
-                if (board[i][j] == 0)
-                    return false;
-
-        for (int i = 0; i < SIZE; i++)
-            for (int j = 0; j < SIZE - 1; j++)
-                if (board[i][j] == board[i][j + 1])
-                    return false;
-
-        for (int i = 0; i < SIZE - 1; i++)
-            for (int j = 0; j < SIZE; j++)
-                if (board[i][j] == board[i + 1][j])
-                    return false;
-
-        return true;
-    }
-
-    bool checkTShapeMerge(int row, int col, int val) {
-        bool merged = false;
-        if (row > 0 && col > 0 && col < SIZE - 1) {
-            if (board[row-1][col] == val && board[row][col-1] == val && board[row][col+1] == val) {
-                board[row-1][col] = 0;
-                board[row][col-1] = 0;
-                board[row][col+1] = 0;
-                board[row][col] = val * 4;
-                score += val * 4;
-                setColor(14);
-                cout << "\nBONUS! T-shape merge of " << val << " found! Next number set to " << val << "!\n";
-                setColor(7);
-                nextNumber = val;
-                merged = true;
-            }
-        }
-        if (row < SIZE - 1 && col > 0 && col < SIZE - 1) {
-            if (board[row+1][col] == val && board[row][col-1] == val && board[row][col+1] == val) {
-                board[row+1][col] = 0;
-                board[row][col-1] = 0;
-                board[row][col+1] = 0;
-                board[row][col] = val * 4;
-                score += val * 4;
-                setColor(14);
-                cout << "\nBONUS! T-shape merge of " << val << " found! Next number set to " << val << "!\n";
-                setColor(7);
-                nextNumber = val;
-                merged = true;
-            }
-        }
-        if (!merged) {
-            if (row < SIZE - 1 && col > 0) {
-                if (board[row][col-1] == val && board[row+1][col] == val) {
-                    board[row][col-1] = 0;
-                    board[row+1][col] = 0;
-                    board[row][col] = val * 4;
-                    score += val * 4;
-                    setColor(14);
-                    cout << "\nBONUS! T-shape merge of " << val << " found! Next number set to " << val << "!\n";
-                    setColor(7);
-                    nextNumber = val;
-                    return true;
-                }
-            }
-            if (row < SIZE - 1 && col < SIZE - 1) {
-                if (board[row][col+1] == val && board[row+1][col] == val) {
-                    board[row][col+1] = 0;
-                    board[row+1][col] = 0;
-                    board[row][col] = val * 4;
-                    score += val * 4;
-                    setColor(14);
-                    cout << "\nBONUS! T-shape merge of " << val << " found! Next number set to " << val << "!\n";
-                    setColor(7);
-                    nextNumber = val;
-                    return true;
-                }
-            }
-        }
-        return merged;
-    }
-
-    bool checkSideTopMerge(int row, int col, int val) {
-        if (row > 0 && col > 0) {
-            if (board[row-1][col] == val && board[row][col-1] == val) {
-                board[row-1][col] = 0;
-                board[row][col-1] = 0;
-                board[row][col] = val * 4;
-                score += val * 4;
-                setColor(14);
-                cout << "\nBONUS! Side-Top merge of " << val << " found! Next number set to " << val << "!\n";
-                setColor(7);
-                nextNumber = val;
-                return true;
-            }
-        }
-        if (row > 0 && col < SIZE - 1) {
-            if (board[row-1][col] == val && board[row][col+1] == val) {
-                board[row-1][col] = 0;
-                board[row][col+1] = 0;
-                board[row][col] = val * 4;
-                score += val * 4;
-                setColor(14);
-                cout << "\nBONUS! Side-Top merge of " << val << " found! Next number set to " << val << "!\n";
-                setColor(7);
-                nextNumber = val;
-                return true;
-            }
-        }
-        return false;
-    }
-
-    bool mergeOnce() {
-        bool changed = false;
-
-        // Check for horizontal four
-        for (int i = 0; i < SIZE; i++) {
-            for (int j = 0; j <= SIZE - 4; j++) {
-                int a = board[i][j];
-                int b = board[i][j + 1];
-                int c = board[i][j + 2];
-                int d = board[i][j + 3];
-                if (a != 0 && a == b && b == c && c == d) {
-                    int targetCol = (lastDropCol >= j && lastDropCol <= j + 3) ? lastDropCol : j + 1;
-                    for (int k = j; k <= j + 3; k++) {
-                        if (k != targetCol) board[i][k] = 0;
-                    }
-                    board[i][targetCol] = a * 8;
-                    score += a * 8;
-                    changed = true;
-                }
-            }
-        }
-
-        // Check for vertical four
-        for (int j = 0; j < SIZE; j++) {
-            for (int i = 0; i <= SIZE - 4; i++) {
-                int a = board[i][j];
-                int b = board[i + 1][j];
-                int c = board[i + 2][j];
-                int d = board[i + 3][j];
-                if (a != 0 && a == b && b == c && c == d) {
-                    int targetRow = (lastDropCol >= i && lastDropCol <= i + 3) ? lastDropCol : i + 2;
-                    for (int k = i; k <= i + 3; k++) {
-                        if (k != targetRow) board[k][j] = 0;
-                    }
-                    board[targetRow][j] = a * 8;
-                    score += a * 8;
-                    changed = true;
-                }
-            }
-        }
-
-        // Check for side-top merges
-        for (int i = 0; i < SIZE; i++) {
-            for (int j = 0; j < SIZE; j++) {
-                if (board[i][j] != 0) {
-                    if (checkSideTopMerge(i, j, board[i][j])) {
-                        changed = true;
-                    }
-                }
-            }
-        }
-
-        // Check for T-shape merges
-        for (int i = 0; i < SIZE; i++) {
-            for (int j = 0; j < SIZE; j++) {
-                if (board[i][j] != 0) {
-                    if (checkTShapeMerge(i, j, board[i][j])) {
-                        changed = true;
-                    }
-                }
-            }
-        }
-
-        for (int i = 0; i < SIZE; i++) {
-            for (int j = 0; j <= SIZE - 3; j++) {
-                int a = board[i][j];
-                int b = board[i][j + 1];
-                int c = board[i][j + 2];
-                if (a != 0 && a == b && b == c) {
-                    int val = a;
-                    int targetCol = j + 1;
-                    if (lastDropCol >= j && lastDropCol <= j + 2) targetCol = lastDropCol;
-                    board[i][targetCol] = val * 4;
-                    for (int k = j; k <= j + 2; k++) if (k != targetCol) board[i][k] = 0;
-                    score += board[i][targetCol];
-                    changed = true;
-                    setColor(14);
-                    cout << "\nBONUS! Horizontal three merge of " << val << " found! Next number set to " << val << "!\n";
-                    setColor(7);
-                    nextNumber = val;
-                }
-            }
-        }
-
-        for (int i = 0; i < SIZE; i++) {
-            for (int j = 0; j < SIZE - 1; j++) {
-                if (board[i][j] != 0 && board[i][j] == board[i][j + 1]) {
-                    if (lastDropCol >= 0 && (j == lastDropCol || j + 1 == lastDropCol)) {
-                        int targetCol = (j == lastDropCol) ? j : j + 1;
-                        int otherCol = (targetCol == j) ? j + 1 : j;
-                        board[i][targetCol] *= 2;
-                        score += board[i][targetCol];
-                        board[i][otherCol] = 0;
-                    } else {
-                        board[i][j] *= 2;
-                        score += board[i][j];
-                        board[i][j + 1] = 0;
-                    }
-                    changed = true;
-                }
-            }
-        }
-
-        for (int j = 0; j < SIZE; j++) {
-            for (int i = 0; i <= SIZE - 3; i++) {
-                int a = board[i][j];
-                int b = board[i + 1][j];
-                int c = board[i + 2][j];
-                if (a != 0 && a == b && b == c) {
-                    int val = a;
-                    int targetRow = i + 2;
-                    board[targetRow][j] = val * 4;
-                    for (int k = i; k <= i + 2; k++) if (k != targetRow) board[k][j] = 0;
-                    score += board[targetRow][j];
-                    changed = true;
-                    setColor(14);
-                    cout << "\nBONUS! Vertical three merge of " << val << " found! Next number set to " << val << "!\n";
-                    setColor(7);
-                    nextNumber = val;
-                }
-            }
-        }
-
-        for (int j = 0; j < SIZE; j++) {
-            for (int i = SIZE - 1; i > 0; i--) {
-                if (board[i][j] != 0 && board[i][j] == board[i - 1][j]) {
-                    board[i][j] *= 2;
-                    score += board[i][j];
-                    board[i - 1][j] = 0;
-                    changed = true;
-                }
-            }
-        }
-
-        return changed;
-    }
-
-    void settle() {
-        for (int col = 0; col < SIZE; col++) {
-            vector<int> tmp;
-            for (int row = SIZE - 1; row >= 0; row--) {
-                if (board[row][col] != 0)
-                    tmp.push_back(board[row][col]);
-            }
-            int rowIdx = SIZE - 1;
-            for (int val : tmp) {
-                board[rowIdx--][col] = val;
-            }
-            while (rowIdx >= 0) {
-                board[rowIdx--][col] = 0;
-            }
-        }
-    }
-
-    void autoMerge() {
-        bool changed;
-        do {
-            settle();
-            changed = mergeOnce();
-            settle();
-        } while (changed);
-    }
-
-    void checkTriangles() {
-        bool bonusGiven = false;
-        for (int i = 0; i < SIZE - 1 && !bonusGiven; i++) {
-            for (int j = 0; j < SIZE - 1 && !bonusGiven; j++) {
-                int val = board[i][j];
-                if (val == 0) continue;
-                if (board[i][j + 1] == val && board[i + 1][j] == val) {
-                    setColor(14);
-                    cout << "\nBONUS! Upper Triangle of " << val << " found! Next number set to " << val << "!\n";
-                    setColor(7);
-                    nextNumber = val;
-                    bonusGiven = true;
-                }
-                else if (board[i + 1][j] == val && board[i + 1][j + 1] == val) {
-                    setColor(14);
-                    cout << "\nBONUS! Lower Triangle of " << val << " found! Next number set to " << val << "!\n";
-                    setColor(7);
-                    nextNumber = val;
-                    bonusGiven = true;
-                }
-            }
-        }
-    }
-
     void showGameOverScreen(bool fromTopMismatch) {
         printBoard();
         setColor(12);
@@ -479,30 +226,25 @@ public:
             cout << "NEW HIGH SCORE! !!" << endl;
         }
         saveScore();
+        saveReplay();
+        if (checkpoints) {
+            checkpoints->clear(0);
+            checkpoints->flush();
+        }
         cout << "Press any key to return to menu...";
         _getch();
     }
 
-    int lowestEmptyInColumn(int col) {
-        for (int i = SIZE - 1; i >= 0; --i) {
-            if (board[i][col] == 0) return i;
+    void playGame(bool resume) {
+        recordingReplay = false;
+        if (!resume || !checkpoints || !checkpoints->load(0, *this)) {
+            gameSeed = (uint32_t)time(0);
+            seedRandom(gameSeed);
+            resetGame();
+            dropHistory.clear();
+            recordingReplay = true;
         }
-        return -1;
-    }
-
-    static int rollRandomTile() {
-        int r = (rand() % 5 + 1);
-        return (1 << r);
-    }
-
-    void playGame() {
-        score = 0;
-        board = vector<vector<int>>(SIZE, vector<int>(SIZE, 0));
-        srand((unsigned)time(0));
-        launcherNumber = rollRandomTile();
-        nextNumber = rollRandomTile();
         selectedColumn = 0;
-        lastDropCol = -1;
         hideCursor(true);
 
         while (true) {
@@ -522,39 +264,18 @@ public:
                 case 77: // RIGHT
                     if (selectedColumn < SIZE - 1) selectedColumn++;
                     break;
-                case 80: { // DOWN
-                    int topVal = board[0][selectedColumn];
-                    if (topVal != 0 && topVal != launcherNumber) {
+                case 80: // DOWN
+                    if (recordingReplay) dropHistory.push_back((uint8_t)selectedColumn);
+                    if (!dropLauncher(selectedColumn)) {
                         showGameOverScreen(true);
                         return;
                     }
-
-                    int insertRow = lowestEmptyInColumn(selectedColumn);
-                    if (insertRow != -1) {
-                        board[insertRow][selectedColumn] = launcherNumber;
-                        lastDropCol = selectedColumn;
-                        autoMerge();
-                        launcherNumber = nextNumber;
-                        nextNumber = rollRandomTile();
-                    } else {
-                        if (topVal == launcherNumber) {
-                            board[0][selectedColumn] *= 2;
-                            score += board[0][selectedColumn];
-                            lastDropCol = selectedColumn;
-                            autoMerge();
-                            launcherNumber = nextNumber;
-                            nextNumber = rollRandomTile();
-                        } else {
-                            showGameOverScreen(true);
-                            return;
-                        }
-                    }
-                    checkTriangles();
+                    if (checkpoints) checkpoints->save(0, *this);
                     break;
                 }
-                }
             }
             else if (input == 'Q' || input == 'q') {
+                if (checkpoints) checkpoints->flush();
                 break;
             }
         }
@@ -584,7 +305,7 @@ public:
         cout << "10. Four identical in line merge to 8 * value, no bonus." << endl;
         cout << "11. If the top cell has a DIFFERENT number than your launcher, shooting there ends the game." << endl;
         cout << "12. If the top cell has the SAME number as your launcher and the column is FULL, the top cell doubles." << endl;
-        cout << "13. Press 'Q' during the game to quit." << endl;
+        cout << "13. Press 'Q' during the game to quit. Your game is kept and can be resumed from Play Game." << endl;
         cout << "-------------------------------" << endl;
         cout << "Press any key to return to menu...";
         _getch();
@@ -726,6 +447,13 @@ public:
         game.hideCursor(false);
     }
 
+    bool askResume() {
+        if (!game.hasSavedGame()) return false;
+        cout << "Resume your saved game? (Y/N) ";
+        int c = _getch();
+        return c == 'Y' || c == 'y';
+    }
+
     void run() {
         welcomeScreen();
         while (true) {
@@ -752,7 +480,7 @@ public:
 
             switch (choice) {
             case 1:
-                game.playGame();
+                game.playGame(askResume());
                 break;
             case 2:
                 instructions();
@@ -773,11 +501,381 @@ public:
     }
 };
 
-int main() {
+// Plays seeded random games on sim and returns the time taken.
+double timeRandomGames(Board& sim, int games, long long& drops, long long& totalScore) {
+    drops = 0;
+    totalScore = 0;
+    srand(12345);
+    sim.seedRandom(12345);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int g = 0; g < games; g++) {
+        sim.resetGame();
+        while (!sim.isGameOver() && sim.dropLauncher(rand() % 5)) {
+            drops++;
+        }
+        totalScore += sim.getScore();
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Bot weightings for the drop cache benchmark. Every seed is played by each
+// of them, so games share their opening positions, and every bot move
+// resolves a trial drop per column, as weight tuning and search do.
+const int CACHE_BENCH_POLICIES = 4;
+const double CACHE_BENCH_WEIGHTS[CACHE_BENCH_POLICIES][BOT_FEATURES] = {
+    { 4.0, 2.0, 8.0, -2.0 },
+    { 6.0, -3.0, 10.0, -1.0 },
+    { 2.0, 4.0, 0.0, -4.0 },
+    { 8.0, 0.0, 4.0, 0.0 }
+};
+
+double timeBotGames(DropCache* cache, int games, long long& drops, long long& totalScore) {
+    drops = 0;
+    totalScore = 0;
+    if (cache) cache->clear();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int g = 0; g < games; g++) {
+        Board sim;
+        sim.setDropCache(cache);
+        sim.seedRandom(1000 + g / CACHE_BENCH_POLICIES);
+        sim.resetGame();
+        const double* weights = CACHE_BENCH_WEIGHTS[g % CACHE_BENCH_POLICIES];
+        for (int d = 0; d < 2000 && !sim.isGameOver(); d++) {
+            if (!sim.dropLauncher(botChooseColumn(sim, weights))) break;
+            drops++;
+        }
+        totalScore += sim.getScore();
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Plays the bot games with and without a DropCache and reports the hit rate
+// and the net speedup of cached resolution. After a warm-up, three rounds
+// alternate which pass goes first, and the fastest pass of each kind counts.
+void benchDropCache(int games) {
+    DropCache cache(1 << 12);
+    long long plainDrops, plainScore, cachedDrops, cachedScore;
+    timeBotGames(0, games / 10 + 1, plainDrops, plainScore);
+    timeBotGames(&cache, games / 10 + 1, cachedDrops, cachedScore);
+
+    double plain = 0, cached = 0;
+    for (int round = 0; round < 3; round++) {
+        for (int pass = 0; pass < 2; pass++) {
+            bool useCache = (round + pass) % 2 == 1;
+            double t = useCache ? timeBotGames(&cache, games, cachedDrops, cachedScore)
+                                : timeBotGames(0, games, plainDrops, plainScore);
+            double& best = useCache ? cached : plain;
+            if (round == 0 || t < best) best = t;
+        }
+    }
+
+    cout << "Games: " << games << " (" << CACHE_BENCH_POLICIES << " bots per seed), drops: "
+         << plainDrops << endl;
+    cout << fixed << setprecision(3);
+    cout << "Uncached: " << plain << " s" << endl;
+    cout << "Cached:   " << cached << " s (" << cache.getSize() << " entries, hit rate "
+         << cache.hitRate() * 100 << "%)" << endl;
+    cout << "Speedup:  " << (cached > 0 ? plain / cached : 0.0) << "x" << endl;
+    if (plainDrops != cachedDrops || plainScore != cachedScore) {
+        cout << "WARNING: cached games diverged from uncached games!" << endl;
+    }
+}
+
+// Plays the same seeded random games with the hand-written merges and with
+// the default rules compiled from data; the results must be identical.
+void benchMergeRules(int games) {
+    Board sim;
+    long long handDrops, handScore, ruleDrops, ruleScore;
+
+    double hand = timeRandomGames(sim, games, handDrops, handScore);
+
+    CompiledRuleSet compiled;
+    if (!compileMergeRules(defaultMergeRules(), compiled)) {
+        cout << "The default merge rules are malformed." << endl;
+        return;
+    }
+    sim.setRules(&compiled);
+    double data = timeRandomGames(sim, games, ruleDrops, ruleScore);
+    sim.setRules(0);
+
+    cout << "Games: " << games << ", drops: " << handDrops << endl;
+    cout << fixed << setprecision(3);
+    cout << "Hand-written rules: " << hand << " s" << endl;
+    cout << "Compiled rules:     " << data << " s" << endl;
+    cout << "Relative speed:     " << (data > 0 ? hand / data : 0.0) << "x" << endl;
+    if (handDrops != ruleDrops || handScore != ruleScore) {
+        cout << "WARNING: compiled rules played differently from the hand-written ones!" << endl;
+    }
+
+    // A merge rule that never removes a tile would keep autoMerge looping.
+    MergeRuleSet malformed;
+    const MergeRule selfDouble = { 0, 2, TARGET_CELL, 0, 1, {{0, 0}} };
+    const MergeRule samePair = { 0, 2, TARGET_CELL, 0, 2, {{0, 0}, {0, 0}} };
+    malformed.merges.push_back(MergePass{ SCAN_ROWS, false, { selfDouble } });
+    CompiledRuleSet rejected;
+    bool accepted = compileMergeRules(malformed, rejected);
+    malformed.merges[0].rules[0] = samePair;
+    accepted = compileMergeRules(malformed, rejected) || accepted;
+    if (accepted) {
+        cout << "WARNING: a malformed rule set compiled!" << endl;
+    }
+}
+
+// Checkpoints many sessions into a fresh store, then times reopening it and
+// restoring every session, which is what a restarted server has to do.
+void benchCheckpoints(int sessions) {
+    const char* path = "bench_sessions.ckpt";
+    remove(path);
+
+    CheckpointStore store;
+    if (!store.open(path, sessions)) {
+        cout << "Could not create " << path << endl;
+        return;
+    }
+    store.setFlushEvery(0);
+    vector<Board> games(sessions);
+    long long savedScore = 0;
+    for (int i = 0; i < sessions; i++) {
+        games[i].seedRandom(777 + i);
+        games[i].resetGame();
+        for (int d = 0; d < 10 && games[i].dropLauncher(games[i].nextRandom() % 5); d++) {}
+        savedScore += games[i].getScore();
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < sessions; i++) {
+        store.save(i, games[i]);
+    }
+    double saveTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    store.flush();
+    double flushTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    store.close();
+
+    start = chrono::steady_clock::now();
+    CheckpointStore reopened;
+    bool ok = reopened.open(path, 0);
+    double openTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    Board sim;
+    long long loadedScore = 0;
+    int restored = 0;
+    for (int i = 0; ok && i < reopened.getSlotCount(); i++) {
+        if (reopened.load(i, sim)) {
+            restored++;
+            loadedScore += sim.getScore();
+        }
+    }
+    double recoverTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    reopened.close();
+    remove(path);
+
+    cout << fixed << setprecision(3);
+    cout << "Sessions: " << sessions << " (" << sizeof(CheckpointSlot) << " bytes per slot)" << endl;
+    cout << "Save all: " << saveTime * 1000 << " ms, msync: " << flushTime * 1000 << " ms" << endl;
+    cout << "Reopen:   " << openTime * 1000 << " ms, restore all: " << recoverTime * 1000 << " ms" << endl;
+    if (restored != sessions || loadedScore != savedScore) {
+        cout << "WARNING: restored sessions do not match what was saved!" << endl;
+    }
+}
+
+// Archives many random games, then times lookups by ID, score and date,
+// and a full scan on one thread and on every core.
+void benchReplayArchive(int games) {
+    const char* path = "bench_replays.nsr";
+    remove(path);
+
+    vector<Replay> played(games);
+    Board sim;
+    srand(4242);
+    long long rawBytes = 0;
+    for (int g = 0; g < games; g++) {
+        Replay& r = played[g];
+        r.date = 1700000000LL + g * 37LL;
+        r.seed = 1000 + g;
+        sim.seedRandom(r.seed);
+        sim.resetGame();
+        while (!sim.isGameOver()) {
+            int col = rand() % 5;
+            r.drops.push_back((uint8_t)col);
+            if (!sim.dropLauncher(col)) break;
+        }
+        r.score = sim.getScore();
+        rawBytes += 8 + 8 + 4 + 4 + 4 + (long long)r.drops.size();
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ReplayArchiveWriter writer;
+    if (!writer.open(path)) {
+        cout << "Could not create " << path << endl;
+        return;
+    }
+    for (int g = 0; g < games; g++) played[g].id = writer.append(played[g]);
+    writer.close();
+    double writeTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    ifstream sized(path, ios::binary | ios::ate);
+    long long fileBytes = (long long)sized.tellg();
+    sized.close();
+
+    ReplayArchiveReader reader;
+    if (!reader.open(path)) {
+        cout << "Could not read " << path << endl;
+        return;
+    }
+    cout << fixed << setprecision(3);
+    cout << "Replays: " << reader.replayCount() << " in " << reader.getBlocks().size() << " blocks" << endl;
+    cout << "Size:    " << fileBytes << " bytes (" << (double)fileBytes / games
+         << " per replay, raw " << (double)rawBytes / games << ")" << endl;
+    cout << "Append:  " << writeTime * 1000 << " ms" << endl;
+
+    start = chrono::steady_clock::now();
+    Replay found;
+    bool hit = reader.findById(played[games / 2].id, found);
+    double idTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "By ID:    " << idTime * 1000 << " ms" << endl;
+
+    vector<Replay> matches;
+    start = chrono::steady_clock::now();
+    size_t decoded = reader.findByDate(played[games / 3].date, played[games / 3].date + 3600, matches);
+    double dateTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "By date:  " << matches.size() << " replays, " << decoded << " blocks decoded, "
+         << dateTime * 1000 << " ms" << endl;
+
+    int best = 0;
+    for (int g = 0; g < games; g++) if (played[g].score > best) best = played[g].score;
+    matches.clear();
+    start = chrono::steady_clock::now();
+    decoded = reader.findByScore(best * 9 / 10, best, matches);
+    double scoreTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "By score: " << matches.size() << " replays, " << decoded << " blocks decoded, "
+         << scoreTime * 1000 << " ms" << endl;
+
+    int threads = (int)thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+    struct ScoreSum {
+        vector<long long> perWorker;
+        void operator()(int worker, const Replay& r) { perWorker[worker] += r.score; }
+    };
+    long long expected = 0;
+    for (int g = 0; g < games; g++) expected += played[g].score;
+    bool scansMatch = true;
+    int threadCounts[2] = { 1, threads };
+    for (int run = 0; run < (threads > 1 ? 2 : 1); run++) {
+        int t = threadCounts[run];
+        ScoreSum sum;
+        sum.perWorker.assign(t, 0);
+        start = chrono::steady_clock::now();
+        reader.forEachParallel(sum, t);
+        double scanTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        long long total = 0;
+        for (int w = 0; w < t; w++) total += sum.perWorker[w];
+        if (total != expected) scansMatch = false;
+        cout << "Full scan on " << t << " thread(s): " << scanTime * 1000 << " ms" << endl;
+    }
+
+    bool replaysMatch = hit && found.drops == played[games / 2].drops;
+    for (int g = 0; g < games && g < 1000; g++) {
+        Replay r;
+        if (!reader.findById(played[g].id, r) || replayGame(sim, r) != played[g].score) replaysMatch = false;
+    }
+    remove(path);
+    if (!replaysMatch || !scansMatch) {
+        cout << "WARNING: archived replays do not match the games that were played!" << endl;
+    }
+}
+
+// Tunes the bot weights, resuming from tuner_checkpoint.txt when it exists
+// and checkpointing after every generation.
+void tuneBotWeights(int generations, int population, int games) {
+    const string path = "tuner_checkpoint.txt";
+    int threads = (int)thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+
+    WeightTuner tuner(population, games, threads);
+    if (tuner.loadCheckpoint(path)) {
+        cout << "Resuming from generation " << tuner.getGeneration() << endl;
+    }
+    cout << fixed << setprecision(2);
+    for (int g = 0; g < generations; g++) {
+        tuner.runGeneration();
+        tuner.saveCheckpoint(path);
+        const WeightTuner::Candidate& top = tuner.getLastGeneration()[0];
+        double seconds = tuner.lastGenerationSeconds();
+        cout << "Generation " << tuner.getGeneration() << ": best " << top.fitness
+             << ", mean weights";
+        for (int k = 0; k < BOT_FEATURES; k++) cout << " " << tuner.getMean()[k];
+        cout << " | " << (seconds > 0 ? tuner.lastGenerationCandidates() / seconds : 0.0)
+             << " candidates/s, " << (seconds > 0 ? tuner.lastGenerationGames() / seconds : 0.0)
+             << " games/s" << endl;
+    }
+
+    const WeightTuner::Candidate& best = tuner.getBest();
+    cout << "Best so far (mean score " << best.fitness << "):" << endl;
+    for (int k = 0; k < BOT_FEATURES; k++) {
+        cout << "  " << BOT_FEATURE_NAMES[k] << ": " << best.weights[k] << endl;
+    }
+}
+
+// argv[index] as a count, or fallback when it is not given. Anything that is
+// not a whole number from 1 to INT_MAX gives 0.
+int countArg(int argc, char* argv[], int index, int fallback) {
+    if (argc <= index) return fallback;
+    char* end;
+    long value = strtol(argv[index], &end, 10);
+    if (end == argv[index] || *end != '\0' || value < 1 || value > INT_MAX) return 0;
+    return (int)value;
+}
+
+int badCount(const char* option) {
+    cout << option << ": counts must be whole numbers of at least 1." << endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    string option = argc > 1 ? argv[1] : "";
+    if (option == "--bench-cache") {
+        int games = countArg(argc, argv, 2, 2000);
+        if (games < 1) return badCount(argv[1]);
+        benchDropCache(games);
+        return 0;
+    }
+    if (option == "--bench-rules") {
+        int games = countArg(argc, argv, 2, 20000);
+        if (games < 1) return badCount(argv[1]);
+        benchMergeRules(games);
+        return 0;
+    }
+    if (option == "--bench-archive") {
+        int games = countArg(argc, argv, 2, 200000);
+        if (games < 1) return badCount(argv[1]);
+        benchReplayArchive(games);
+        return 0;
+    }
+    if (option == "--tune") {
+        int generations = countArg(argc, argv, 2, 20);
+        int population = countArg(argc, argv, 3, 16);
+        int games = countArg(argc, argv, 4, 64);
+        if (generations < 1 || population < 1 || games < 1) return badCount(argv[1]);
+        tuneBotWeights(generations, population, games);
+        return 0;
+    }
+    if (option == "--bench-checkpoint") {
+        int sessions = countArg(argc, argv, 2, 100000);
+        if (sessions < 1) return badCount(argv[1]);
+        benchCheckpoints(sessions);
+        return 0;
+    }
+
     HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
     if (hConsole == INVALID_HANDLE_VALUE) return 1;
     
+    CheckpointStore checkpoints;
     GameBoard gameBoard;
+    if (checkpoints.open("sessions.ckpt", 1)) {
+        gameBoard.setCheckpointStore(&checkpoints);
+    } else {
+        cout << "Could not open sessions.ckpt; games will not be checkpointed." << endl;
+        Sleep(800);
+    }
     GameMenu menu(gameBoard);
     menu.run();
     
@@ -0,0 +1,294 @@
+#ifndef MERGE_RULES_H
+#define MERGE_RULES_H
+
+#include <cstddef>
+#include <vector>
+
+const int BOARD_SIZE = 5;
+const int MAX_RULE_CELLS = 5;
+
+// Where the merged value lands.
+enum TargetPolicy {
+    TARGET_CELL,          // always cells[targetCell]
+    TARGET_DROP_IN_LINE   // the cell at lastDropCol along a straight run, else cells[targetCell]
+};
+
+// Order in which anchors are visited; later matches see earlier merges.
+enum ScanOrder {
+    SCAN_ROWS,              // top row first, left to right
+    SCAN_COLUMNS,           // left column first, top to bottom
+    SCAN_COLUMNS_BOTTOM_UP  // left column first, bottom to top
+};
+
+// One merge shape. cells are (row, col) offsets from the anchor cell and all
+// of them must hold the same nonzero value. The merged cell becomes
+// value * multiplier and the others are cleared; a multiplier of 0 leaves the
+// board alone. A non-null bonus names the bonus and sets the next number.
+struct MergeRule {
+    const char* bonus;
+    int multiplier;
+    TargetPolicy target;
+    int targetCell;
+    int cellCount;
+    int cells[MAX_RULE_CELLS][2];
+};
+
+// Rules tried at each anchor in order; the first match at an anchor wins.
+// stopAfterFirst ends the whole pass at the first match on the board.
+struct MergePass {
+    ScanOrder order;
+    bool stopAfterFirst;
+    std::vector<MergeRule> rules;
+};
+
+// merges run in order on every autoMerge round; bonuses run once after
+// each drop, once the launcher has moved on (like checkTriangles).
+struct MergeRuleSet {
+    std::vector<MergePass> merges;
+    std::vector<MergePass> bonuses;
+};
+
+// Bitmasks over the row-major board, rebuilt after every merge. Bit k of
+// sameRight (sameBelow) is set when cell k is nonzero and equals its right
+// (lower) neighbour.
+struct BoardMasks {
+    unsigned occupied;
+    unsigned sameRight;
+    unsigned sameBelow;
+};
+
+// A rule pinned to one anchor: cell indices into the row-major board and the
+// merged cell for every lastDropCol from -1 to BOARD_SIZE - 1. When the cells
+// are 4-connected, sameRight/sameBelow list the edges of a spanning tree and
+// the rule matches exactly when all of them are set in BoardMasks and every
+// cell of mask is occupied.
+struct RulePlacement {
+    bool connected;
+    unsigned mask;    // bit per board cell the rule covers
+    unsigned sameRight;
+    unsigned sameBelow;
+    unsigned char cells[MAX_RULE_CELLS];
+    unsigned char cellCount;
+    unsigned char target[BOARD_SIZE + 1];
+    short rule;
+    int anchorEnd;    // first placement of the next anchor
+};
+
+// Per-rule prefilter: shifting the BoardMasks by each spanning-tree edge's
+// offset from the anchor and ANDing them gives every anchor where the rule
+// matches, for all anchors at once. Rules without edges (one cell, or cells
+// that are not 4-connected) are filtered on their first cell being occupied.
+struct RuleFilter {
+    unsigned anchors;   // anchors where the rule fits on the board
+    int firstCellOffset;
+    int edgeCount;
+    int edgeOffset[MAX_RULE_CELLS];
+    bool edgeBelow[MAX_RULE_CELLS];
+};
+
+struct CompiledPass {
+    bool stopAfterFirst;
+    std::vector<MergeRule> rules;
+    std::vector<RuleFilter> filters;
+    std::vector<RulePlacement> placements;
+
+    // False when no rule of the pass can match the board.
+    bool mayMatch(const BoardMasks& m) const {
+        for (size_t r = 0; r < filters.size(); r++) {
+            const RuleFilter& f = filters[r];
+            unsigned hits = f.anchors;
+            if (f.edgeCount == 0) {
+                int o = f.firstCellOffset;
+                hits &= o >= 0 ? m.occupied >> o : m.occupied << -o;
+            }
+            for (int e = 0; hits && e < f.edgeCount; e++) {
+                unsigned edges = f.edgeBelow[e] ? m.sameBelow : m.sameRight;
+                int o = f.edgeOffset[e];
+                hits &= o >= 0 ? edges >> o : edges << -o;
+            }
+            if (hits) return true;
+        }
+        return false;
+    }
+};
+
+struct CompiledRuleSet {
+    std::vector<CompiledPass> merges;
+    std::vector<CompiledPass> bonuses;
+};
+
+// The rules Board::mergeOnce and checkTriangles implement by hand.
+inline MergeRuleSet defaultMergeRules() {
+    const MergeRule horizontalFour = { 0, 8, TARGET_DROP_IN_LINE, 1, 4, {{0, 0}, {0, 1}, {0, 2}, {0, 3}} };
+    const MergeRule verticalFour = { 0, 8, TARGET_DROP_IN_LINE, 2, 4, {{0, 0}, {1, 0}, {2, 0}, {3, 0}} };
+    const MergeRule sideTopLeft = { "Side-Top merge", 4, TARGET_CELL, 0, 3, {{0, 0}, {-1, 0}, {0, -1}} };
+    const MergeRule sideTopRight = { "Side-Top merge", 4, TARGET_CELL, 0, 3, {{0, 0}, {-1, 0}, {0, 1}} };
+    const MergeRule tUp = { "T-shape merge", 4, TARGET_CELL, 0, 4, {{0, 0}, {-1, 0}, {0, -1}, {0, 1}} };
+    const MergeRule tDown = { "T-shape merge", 4, TARGET_CELL, 0, 4, {{0, 0}, {1, 0}, {0, -1}, {0, 1}} };
+    const MergeRule lLeft = { "T-shape merge", 4, TARGET_CELL, 0, 3, {{0, 0}, {0, -1}, {1, 0}} };
+    const MergeRule lRight = { "T-shape merge", 4, TARGET_CELL, 0, 3, {{0, 0}, {0, 1}, {1, 0}} };
+    const MergeRule horizontalThree = { "Horizontal three merge", 4, TARGET_DROP_IN_LINE, 1, 3, {{0, 0}, {0, 1}, {0, 2}} };
+    const MergeRule horizontalPair = { 0, 2, TARGET_DROP_IN_LINE, 0, 2, {{0, 0}, {0, 1}} };
+    const MergeRule verticalThree = { "Vertical three merge", 4, TARGET_CELL, 2, 3, {{0, 0}, {1, 0}, {2, 0}} };
+    const MergeRule verticalPair = { 0, 2, TARGET_CELL, 0, 2, {{0, 0}, {-1, 0}} };
+    const MergeRule upperTriangle = { "Upper Triangle", 0, TARGET_CELL, 0, 3, {{0, 0}, {0, 1}, {1, 0}} };
+    const MergeRule lowerTriangle = { "Lower Triangle", 0, TARGET_CELL, 0, 3, {{0, 0}, {1, 0}, {1, 1}} };
+
+    MergeRuleSet set;
+    set.merges.push_back(MergePass{ SCAN_ROWS, false, { horizontalFour } });
+    set.merges.push_back(MergePass{ SCAN_COLUMNS, false, { verticalFour } });
+    set.merges.push_back(MergePass{ SCAN_ROWS, false, { sideTopLeft, sideTopRight } });
+    set.merges.push_back(MergePass{ SCAN_ROWS, false, { tUp, tDown, lLeft, lRight } });
+    set.merges.push_back(MergePass{ SCAN_ROWS, false, { horizontalThree } });
+    set.merges.push_back(MergePass{ SCAN_ROWS, false, { horizontalPair } });
+    set.merges.push_back(MergePass{ SCAN_COLUMNS, false, { verticalThree } });
+    set.merges.push_back(MergePass{ SCAN_COLUMNS_BOTTOM_UP, false, { verticalPair } });
+    set.bonuses.push_back(MergePass{ SCAN_ROWS, true, { upperTriangle, lowerTriangle } });
+    return set;
+}
+
+// Walks the placement's cells from the first one, recording each 4-adjacent
+// step as a sameRight/sameBelow edge.
+inline void linkCells(RulePlacement& p) {
+    p.sameRight = p.sameBelow = 0;
+    unsigned reached = 1u << p.cells[0];
+    int stack[MAX_RULE_CELLS];
+    int top = 0;
+    stack[top++] = p.cells[0];
+    while (top > 0) {
+        int u = stack[--top];
+        for (int c = 0; c < p.cellCount; c++) {
+            int v = p.cells[c];
+            if (reached & (1u << v)) continue;
+            bool sameRow = u / BOARD_SIZE == v / BOARD_SIZE;
+            if (sameRow && v == u + 1) p.sameRight |= 1u << u;
+            else if (sameRow && v == u - 1) p.sameRight |= 1u << v;
+            else if (v == u + BOARD_SIZE) p.sameBelow |= 1u << u;
+            else if (v == u - BOARD_SIZE) p.sameBelow |= 1u << v;
+            else continue;
+            reached |= 1u << v;
+            stack[top++] = v;
+        }
+    }
+    p.connected = reached == p.mask;
+}
+
+// A rule needs 1 to MAX_RULE_CELLS distinct cells, a targetCell among them
+// and a multiplier of at least 0. autoMerge repeats the merge passes until
+// nothing changes, which only ends because every merge there removes a tile:
+// a merge rule that changes the board needs at least two cells.
+inline bool isValidMergeRule(const MergeRule& rule, bool repeated) {
+    if (rule.cellCount <= 0 || rule.cellCount > MAX_RULE_CELLS) return false;
+    if (rule.targetCell < 0 || rule.targetCell >= rule.cellCount) return false;
+    if (rule.multiplier < 0) return false;
+    if (repeated && rule.multiplier != 0 && rule.cellCount < 2) return false;
+    for (int a = 0; a < rule.cellCount; a++) {
+        for (int b = a + 1; b < rule.cellCount; b++) {
+            if (rule.cells[a][0] == rule.cells[b][0] && rule.cells[a][1] == rule.cells[b][1]) return false;
+        }
+    }
+    return true;
+}
+
+// Resolves every rule of the pass against every anchor up front, so matching
+// needs no bounds checks or target arithmetic at play time. Anchors where a
+// rule leaves the board are skipped; compileMergeRules rejects malformed rules
+// before they get here.
+inline CompiledPass compileMergePass(const MergePass& pass) {
+    CompiledPass out;
+    out.stopAfterFirst = pass.stopAfterFirst;
+    out.rules = pass.rules;
+    out.filters.resize(pass.rules.size());
+    for (size_t r = 0; r < out.filters.size(); r++) {
+        out.filters[r].anchors = 0;
+        out.filters[r].firstCellOffset = 0;
+        out.filters[r].edgeCount = 0;
+    }
+
+    for (int outer = 0; outer < BOARD_SIZE; outer++) {
+        for (int inner = 0; inner < BOARD_SIZE; inner++) {
+            int row, col;
+            if (pass.order == SCAN_ROWS) { row = outer; col = inner; }
+            else if (pass.order == SCAN_COLUMNS) { row = inner; col = outer; }
+            else { row = BOARD_SIZE - 1 - inner; col = outer; }
+
+            size_t anchorStart = out.placements.size();
+            for (size_t r = 0; r < pass.rules.size(); r++) {
+                const MergeRule& rule = pass.rules[r];
+                RulePlacement p;
+                bool inside = rule.cellCount > 0 && rule.cellCount <= MAX_RULE_CELLS &&
+                              rule.targetCell >= 0 && rule.targetCell < rule.cellCount;
+                bool sameRow = true, sameCol = true;
+                for (int c = 0; inside && c < rule.cellCount; c++) {
+                    int rr = row + rule.cells[c][0];
+                    int cc = col + rule.cells[c][1];
+                    inside = rr >= 0 && rr < BOARD_SIZE && cc >= 0 && cc < BOARD_SIZE;
+                    p.cells[c] = (unsigned char)(rr * BOARD_SIZE + cc);
+                    if (rule.cells[c][0] != rule.cells[0][0]) sameRow = false;
+                    if (rule.cells[c][1] != rule.cells[0][1]) sameCol = false;
+                }
+                if (!inside) continue;
+                p.cellCount = (unsigned char)rule.cellCount;
+                p.mask = 0;
+                for (int c = 0; c < rule.cellCount; c++) p.mask |= 1u << p.cells[c];
+                linkCells(p);
+
+                int anchor = row * BOARD_SIZE + col;
+                RuleFilter& f = out.filters[r];
+                if (f.anchors == 0) {
+                    f.firstCellOffset = p.cells[0] - anchor;
+                    for (int k = 0; p.connected && k < BOARD_SIZE * BOARD_SIZE; k++) {
+                        if (p.sameRight & (1u << k)) {
+                            f.edgeOffset[f.edgeCount] = k - anchor;
+                            f.edgeBelow[f.edgeCount++] = false;
+                        }
+                        if (p.sameBelow & (1u << k)) {
+                            f.edgeOffset[f.edgeCount] = k - anchor;
+                            f.edgeBelow[f.edgeCount++] = true;
+                        }
+                    }
+                }
+                f.anchors |= 1u << anchor;
+                p.rule = (short)r;
+                p.anchorEnd = 0;
+
+                for (int drop = -1; drop < BOARD_SIZE; drop++) {
+                    int t = rule.targetCell;
+                    if (rule.target == TARGET_DROP_IN_LINE && (sameRow || sameCol)) {
+                        for (int c = 0; c < rule.cellCount; c++) {
+                            int along = sameRow ? p.cells[c] % BOARD_SIZE : p.cells[c] / BOARD_SIZE;
+                            if (along == drop) t = c;
+                        }
+                    }
+                    p.target[drop + 1] = p.cells[t];
+                }
+                out.placements.push_back(p);
+            }
+            for (size_t k = anchorStart; k < out.placements.size(); k++) {
+                out.placements[k].anchorEnd = (int)out.placements.size();
+            }
+        }
+    }
+    return out;
+}
+
+inline bool isValidMergePasses(const std::vector<MergePass>& passes, bool repeated) {
+    for (size_t i = 0; i < passes.size(); i++) {
+        for (size_t r = 0; r < passes[i].rules.size(); r++) {
+            if (!isValidMergeRule(passes[i].rules[r], repeated)) return false;
+        }
+    }
+    return true;
+}
+
+// Returns false, leaving out untouched, when any rule is malformed.
+inline bool compileMergeRules(const MergeRuleSet& set, CompiledRuleSet& out) {
+    if (!isValidMergePasses(set.merges, true) || !isValidMergePasses(set.bonuses, false)) return false;
+    CompiledRuleSet compiled;
+    for (size_t i = 0; i < set.merges.size(); i++) compiled.merges.push_back(compileMergePass(set.merges[i]));
+    for (size_t i = 0; i < set.bonuses.size(); i++) compiled.bonuses.push_back(compileMergePass(set.bonuses[i]));
+    out = compiled;
+    return true;
+}
+
+#endif
@@ -0,0 +1,701 @@
+#ifndef REPLAY_ARCHIVE_H
+#define REPLAY_ARCHIVE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// One finished game: the tile RNG seed and the column of every drop are
+// enough to replay it exactly on a Board.
+struct Replay {
+    uint64_t id;
+    int64_t date;       // seconds since the epoch
+    uint32_t seed;
+    int32_t score;
+    std::vector<uint8_t> drops;
+};
+
+// Plays r back on b and returns the final score.
+inline int replayGame(Board& b, const Replay& r) {
+    b.seedRandom(r.seed);
+    b.resetGame();
+    for (size_t i = 0; i < r.drops.size() && !b.isGameOver(); i++) {
+        if (!b.dropLauncher(r.drops[i])) break;
+    }
+    return b.getScore();
+}
+
+// Footer entry for one block; queries use the ranges to skip whole blocks.
+// offset points at the block header, size counts the payload after it.
+struct ReplayBlockInfo {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t count;
+    uint64_t firstId, lastId;
+    int64_t minDate, maxDate;
+    int32_t minScore, maxScore;
+};
+
+// Adaptive binary range coder (the LZMA scheme). Drop columns are coded as a
+// 3-bit tree whose probabilities are conditioned on the previous column.
+class ReplayRangeEncoder {
+private:
+    std::vector<uint8_t>& out;
+    uint64_t low;
+    uint32_t range;
+    uint8_t cache;
+    uint64_t cacheSize;
+
+    void shiftLow() {
+        if ((uint32_t)low < 0xFF000000u || (low >> 32) != 0) {
+            uint8_t carry = (uint8_t)(low >> 32);
+            uint8_t temp = cache;
+            do {
+                out.push_back((uint8_t)(temp + carry));
+                temp = 0xFF;
+            } while (--cacheSize != 0);
+            cache = (uint8_t)(low >> 24);
+        }
+        cacheSize++;
+        low = (low & 0x00FFFFFFu) << 8;
+    }
+
+public:
+    explicit ReplayRangeEncoder(std::vector<uint8_t>& o)
+        : out(o), low(0), range(0xFFFFFFFFu), cache(0), cacheSize(1) {}
+
+    void encodeBit(uint16_t& prob, int bit) {
+        uint32_t bound = (range >> 11) * prob;
+        if (bit == 0) {
+            range = bound;
+            prob += (2048 - prob) >> 5;
+        } else {
+            low += bound;
+            range -= bound;
+            prob -= prob >> 5;
+        }
+        while (range < (1u << 24)) {
+            range <<= 8;
+            shiftLow();
+        }
+    }
+
+    void finish() {
+        for (int i = 0; i < 5; i++) shiftLow();
+    }
+};
+
+class ReplayRangeDecoder {
+private:
+    const uint8_t* in;
+    const uint8_t* end;
+    uint32_t range;
+    uint32_t code;
+
+    uint8_t nextByte() { return in < end ? *in++ : 0; }
+
+public:
+    ReplayRangeDecoder(const uint8_t* begin, const uint8_t* stop)
+        : in(begin), end(stop), range(0xFFFFFFFFu), code(0) {
+        for (int i = 0; i < 5; i++) code = (code << 8) | nextByte();
+    }
+
+    int decodeBit(uint16_t& prob) {
+        uint32_t bound = (range >> 11) * prob;
+        int bit;
+        if (code < bound) {
+            range = bound;
+            prob += (2048 - prob) >> 5;
+            bit = 0;
+        } else {
+            code -= bound;
+            range -= bound;
+            prob -= prob >> 5;
+            bit = 1;
+        }
+        while (range < (1u << 24)) {
+            range <<= 8;
+            code = (code << 8) | nextByte();
+        }
+        return bit;
+    }
+};
+
+// Column model: context BOARD_SIZE is "first drop of the game".
+struct ReplayDropModel {
+    uint16_t probs[BOARD_SIZE + 1][8];
+
+    ReplayDropModel() {
+        for (int c = 0; c <= BOARD_SIZE; c++)
+            for (int i = 0; i < 8; i++)
+                probs[c][i] = 1024;
+    }
+
+    void encode(ReplayRangeEncoder& rc, int context, int col) {
+        int m = 1;
+        for (int i = 2; i >= 0; i--) {
+            int bit = (col >> i) & 1;
+            rc.encodeBit(probs[context][m], bit);
+            m = (m << 1) | bit;
+        }
+    }
+
+    int decode(ReplayRangeDecoder& rc, int context) {
+        int m = 1;
+        for (int i = 0; i < 3; i++) m = (m << 1) | rc.decodeBit(probs[context][m]);
+        return m - 8;
+    }
+};
+
+namespace replay_format {
+
+const char MAGIC[8] = { 'N', 'S', 'Q', 'R', 'P', 'L', 'Y', '2' };
+const int TRAILER_SIZE = 8 + 4 + 4 + 8;   // footer offset, block count, footer checksum, magic
+const int INDEX_ENTRY_SIZE = 8 + 4 + 4 + 8 + 8 + 8 + 8 + 4 + 4;
+const int BLOCK_HEADER_SIZE = 4 + 4;      // payload size, payload checksum
+
+// Every replay header in a block takes at least five varint bytes.
+const int MIN_REPLAY_BYTES = 5;
+// The range coder's probabilities saturate at 2017/2048, so a drop (three
+// coded bits) costs at least 0.066 bits and a byte holds at most ~121 drops.
+const uint64_t MAX_DROPS_PER_BYTE = 128;
+
+// FNV-1a, as for checkpoint records.
+inline uint32_t checksum(const uint8_t* p, size_t n, uint32_t h = 2166136261u) {
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+inline void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+inline void putFixed(std::vector<uint8_t>& out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+inline uint64_t getFixed(const uint8_t*& p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v |= (uint64_t)*p++ << (8 * i);
+    return v;
+}
+
+// Block layout: replay count, then per replay the id and date as deltas from
+// the previous replay, the seed relative to the date (interactive games seed
+// from the clock), score and drop count, all varints. The range-coded drops
+// of every replay in the block follow.
+inline void encodeBlock(const std::vector<Replay>& replays, std::vector<uint8_t>& out) {
+    putVarint(out, replays.size());
+    uint64_t prevId = 0;
+    int64_t prevDate = 0;
+    for (size_t i = 0; i < replays.size(); i++) {
+        const Replay& r = replays[i];
+        putVarint(out, r.id - prevId);
+        putVarint(out, zigzag(r.date - prevDate));
+        putVarint(out, zigzag((int64_t)(int32_t)(r.seed - (uint32_t)r.date)));
+        putVarint(out, zigzag(r.score));
+        putVarint(out, r.drops.size());
+        prevId = r.id;
+        prevDate = r.date;
+    }
+    ReplayDropModel model;
+    ReplayRangeEncoder rc(out);
+    for (size_t i = 0; i < replays.size(); i++) {
+        int context = BOARD_SIZE;
+        for (size_t d = 0; d < replays[i].drops.size(); d++) {
+            model.encode(rc, context, replays[i].drops[d]);
+            context = replays[i].drops[d];
+        }
+    }
+    rc.finish();
+}
+
+inline bool decodeBlock(const std::vector<uint8_t>& data, std::vector<Replay>& replays) {
+    const uint8_t* p = data.data();
+    const uint8_t* end = p + data.size();
+    uint64_t count, v;
+    if (!getVarint(p, end, count)) return false;
+    if (count > (uint64_t)(end - p) / MIN_REPLAY_BYTES) return false;
+    replays.resize((size_t)count);
+    uint64_t totalDrops = 0;
+    uint64_t prevId = 0;
+    int64_t prevDate = 0;
+    for (size_t i = 0; i < replays.size(); i++) {
+        Replay& r = replays[i];
+        if (!getVarint(p, end, v)) return false;
+        r.id = prevId + v;
+        if (!getVarint(p, end, v)) return false;
+        r.date = prevDate + unzigzag(v);
+        if (!getVarint(p, end, v)) return false;
+        r.seed = (uint32_t)r.date + (uint32_t)unzigzag(v);
+        if (!getVarint(p, end, v)) return false;
+        r.score = (int32_t)unzigzag(v);
+        if (!getVarint(p, end, v)) return false;
+        // Checked against what the rest of the block could possibly encode,
+        // so a corrupt count cannot trigger a huge allocation.
+        totalDrops += v;
+        if (v > totalDrops || totalDrops > (uint64_t)(end - p) * MAX_DROPS_PER_BYTE + 8) return false;
+        r.drops.resize((size_t)v);
+        prevId = r.id;
+        prevDate = r.date;
+    }
+    ReplayDropModel model;
+    ReplayRangeDecoder rc(p, end);
+    for (size_t i = 0; i < replays.size(); i++) {
+        int context = BOARD_SIZE;
+        for (size_t d = 0; d < replays[i].drops.size(); d++) {
+            int col = model.decode(rc, context);
+            if (col >= BOARD_SIZE) return false;
+            replays[i].drops[d] = (uint8_t)col;
+            context = col;
+        }
+    }
+    return true;
+}
+
+inline void encodeIndex(const std::vector<ReplayBlockInfo>& blocks, std::vector<uint8_t>& out) {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const ReplayBlockInfo& b = blocks[i];
+        putFixed(out, b.offset, 8);
+        putFixed(out, b.size, 4);
+        putFixed(out, b.count, 4);
+        putFixed(out, b.firstId, 8);
+        putFixed(out, b.lastId, 8);
+        putFixed(out, (uint64_t)b.minDate, 8);
+        putFixed(out, (uint64_t)b.maxDate, 8);
+        putFixed(out, (uint32_t)b.minScore, 4);
+        putFixed(out, (uint32_t)b.maxScore, 4);
+    }
+}
+
+// Footer index followed by the trailer. The checksum covers the index and
+// the trailer fields before it.
+inline void encodeFooter(const std::vector<ReplayBlockInfo>& blocks, uint64_t footerOffset,
+                         std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    encodeIndex(blocks, out);
+    putFixed(out, footerOffset, 8);
+    putFixed(out, blocks.size(), 4);
+    putFixed(out, checksum(out.data() + start, out.size() - start), 4);
+    out.insert(out.end(), MAGIC, MAGIC + 8);
+}
+
+// The block header sits at ReplayBlockInfo::offset, just before the payload.
+inline void encodeBlockHeader(const std::vector<uint8_t>& payload, std::vector<uint8_t>& out) {
+    putFixed(out, payload.size(), 4);
+    putFixed(out, checksum(payload.data(), payload.size()), 4);
+}
+
+inline bool checkBlockHeader(const uint8_t* header, const std::vector<uint8_t>& payload) {
+    const uint8_t* p = header;
+    uint32_t size = (uint32_t)getFixed(p, 4);
+    uint32_t sum = (uint32_t)getFixed(p, 4);
+    return size == payload.size() && sum == checksum(payload.data(), payload.size());
+}
+
+// Parses and validates the footer whose trailer ends at end. Blocks must lie
+// before the footer in file order with ascending IDs, so a footer that passes
+// can be trusted by the reader's binary search and buffer sizes.
+inline int64_t readFooterAt(std::ifstream& file, int64_t end, std::vector<ReplayBlockInfo>& blocks) {
+    blocks.clear();
+    if (end < TRAILER_SIZE) return -1;
+    uint8_t trailer[TRAILER_SIZE];
+    file.clear();
+    file.seekg(end - TRAILER_SIZE);
+    if (!file.read((char*)trailer, TRAILER_SIZE)) return -1;
+    if (memcmp(trailer + 16, MAGIC, 8) != 0) return -1;
+    const uint8_t* p = trailer;
+    int64_t footerOffset = (int64_t)getFixed(p, 8);
+    uint32_t blockCount = (uint32_t)getFixed(p, 4);
+    uint32_t sum = (uint32_t)getFixed(p, 4);
+    if (footerOffset < 0 || footerOffset > end ||
+        footerOffset + (int64_t)blockCount * INDEX_ENTRY_SIZE + TRAILER_SIZE != end) {
+        return -1;
+    }
+
+    std::vector<uint8_t> footer((size_t)blockCount * INDEX_ENTRY_SIZE);
+    file.seekg(footerOffset);
+    if (!footer.empty() && !file.read((char*)footer.data(), footer.size())) return -1;
+    if (checksum(trailer, 8 + 4, checksum(footer.data(), footer.size())) != sum) return -1;
+
+    p = footer.data();
+    blocks.resize(blockCount);
+    uint64_t prevEnd = 0;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        ReplayBlockInfo& b = blocks[i];
+        b.offset = getFixed(p, 8);
+        b.size = (uint32_t)getFixed(p, 4);
+        b.count = (uint32_t)getFixed(p, 4);
+        b.firstId = getFixed(p, 8);
+        b.lastId = getFixed(p, 8);
+        b.minDate = (int64_t)getFixed(p, 8);
+        b.maxDate = (int64_t)getFixed(p, 8);
+        b.minScore = (int32_t)getFixed(p, 4);
+        b.maxScore = (int32_t)getFixed(p, 4);
+
+        uint64_t room = (uint64_t)footerOffset;
+        bool valid = b.offset >= prevEnd && b.offset <= room && room - b.offset >= BLOCK_HEADER_SIZE &&
+                     b.size <= room - b.offset - BLOCK_HEADER_SIZE &&
+                     b.count > 0 && b.count <= b.size / MIN_REPLAY_BYTES &&
+                     b.lastId >= b.firstId && b.lastId - b.firstId == b.count - 1u &&
+                     (i == 0 || b.firstId > blocks[i - 1].lastId);
+        if (!valid) {
+            blocks.clear();
+            return -1;
+        }
+        prevEnd = b.offset + BLOCK_HEADER_SIZE + b.size;
+    }
+    return footerOffset;
+}
+
+// Reads the trailer and footer index. A writer that stopped before its
+// trailer leaves bytes after the last good one, so when the end of the file
+// is not a valid trailer the newest valid one before it is used. Returns the
+// footer offset, or -1 when the file is not an archive.
+inline int64_t readIndex(std::ifstream& file, std::vector<ReplayBlockInfo>& blocks) {
+    blocks.clear();
+    file.seekg(0, std::ios::end);
+    int64_t fileSize = (int64_t)file.tellg();
+    int64_t footerOffset = readFooterAt(file, fileSize, blocks);
+    if (footerOffset >= 0) return footerOffset;
+
+    const int64_t CHUNK = 1 << 16;
+    std::vector<char> buffer((size_t)CHUNK + 8);
+    for (int64_t chunkEnd = fileSize; chunkEnd > 0; chunkEnd -= CHUNK) {
+        int64_t chunkStart = chunkEnd > CHUNK ? chunkEnd - CHUNK : 0;
+        int64_t readEnd = chunkEnd + 7 < fileSize ? chunkEnd + 7 : fileSize;
+        size_t n = (size_t)(readEnd - chunkStart);
+        file.clear();
+        file.seekg(chunkStart);
+        if (!file.read(buffer.data(), n)) return -1;
+        for (size_t i = n >= 8 ? n - 8 + 1 : 0; i-- > 0; ) {
+            if (buffer[i] != MAGIC[0] || memcmp(buffer.data() + i, MAGIC, 8) != 0) continue;
+            footerOffset = readFooterAt(file, chunkStart + (int64_t)i + 8, blocks);
+            if (footerOffset >= 0) return footerOffset;
+        }
+    }
+    return -1;
+}
+
+}
+
+// Streams replays into an archive. Replays are buffered into blocks of
+// blockSize and written as each block fills; close() writes the footer
+// index. Reopening an archive picks up its last, partly filled block so
+// appending one game at a time still produces full blocks.
+//
+// Committed bytes are never overwritten: new and refilled blocks go after
+// the current end of the file and close() appends a fresh footer, so a crash
+// at any point leaves the previous footer in place for readIndex to find.
+// The superseded bytes are reclaimed by rewriting the archive to a temporary
+// file once they outweigh the live ones.
+class ReplayArchiveWriter {
+private:
+    std::fstream file;
+    std::string path;
+    std::vector<ReplayBlockInfo> blocks;
+    std::vector<Replay> pending;
+    uint64_t writeOffset;
+    uint64_t nextId;
+    size_t blockSize;
+    bool appended;
+
+    void writeBlock() {
+        if (pending.empty()) return;
+        std::vector<uint8_t> payload;
+        replay_format::encodeBlock(pending, payload);
+        std::vector<uint8_t> data;
+        replay_format::encodeBlockHeader(payload, data);
+        data.insert(data.end(), payload.begin(), payload.end());
+
+        ReplayBlockInfo info;
+        info.offset = writeOffset;
+        info.size = (uint32_t)payload.size();
+        info.count = (uint32_t)pending.size();
+        info.firstId = pending.front().id;
+        info.lastId = pending.back().id;
+        info.minDate = info.maxDate = pending[0].date;
+        info.minScore = info.maxScore = pending[0].score;
+        for (size_t i = 1; i < pending.size(); i++) {
+            if (pending[i].date < info.minDate) info.minDate = pending[i].date;
+            if (pending[i].date > info.maxDate) info.maxDate = pending[i].date;
+            if (pending[i].score < info.minScore) info.minScore = pending[i].score;
+            if (pending[i].score > info.maxScore) info.maxScore = pending[i].score;
+        }
+
+        file.seekp((std::streamoff)writeOffset);
+        file.write((const char*)data.data(), data.size());
+        writeOffset += data.size();
+        blocks.push_back(info);
+        pending.clear();
+    }
+
+    void writeFooter() {
+        std::vector<uint8_t> tail;
+        replay_format::encodeFooter(blocks, writeOffset, tail);
+        file.seekp((std::streamoff)writeOffset);
+        file.write((const char*)tail.data(), tail.size());
+        writeOffset += tail.size();
+        file.flush();
+    }
+
+    uint64_t liveBytes() const {
+        uint64_t live = replay_format::TRAILER_SIZE + blocks.size() * replay_format::INDEX_ENTRY_SIZE;
+        for (size_t b = 0; b < blocks.size(); b++) live += replay_format::BLOCK_HEADER_SIZE + blocks[b].size;
+        return live;
+    }
+
+    // Copies the live blocks and a new footer to path.tmp and swaps it in.
+    // On any failure the archive in place is left as it was.
+    bool compact() {
+        std::string tmp = path + ".tmp";
+        std::vector<ReplayBlockInfo> moved = blocks;
+        {
+            std::ifstream in(path.c_str(), std::ios::binary);
+            std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+            if (!in || !out) return false;
+            std::vector<char> data;
+            uint64_t offset = 0;
+            for (size_t b = 0; b < moved.size(); b++) {
+                data.resize(replay_format::BLOCK_HEADER_SIZE + moved[b].size);
+                in.seekg((std::streamoff)moved[b].offset);
+                if (!in.read(data.data(), data.size())) return false;
+                out.write(data.data(), data.size());
+                moved[b].offset = offset;
+                offset += data.size();
+            }
+            std::vector<uint8_t> tail;
+            replay_format::encodeFooter(moved, offset, tail);
+            out.write((const char*)tail.data(), tail.size());
+            out.flush();
+            if (!out) return false;
+        }
+#ifdef _WIN32
+        return MoveFileExA(tmp.c_str(), path.c_str(),
+                           MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        return rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+    }
+
+public:
+    ReplayArchiveWriter() : writeOffset(0), nextId(1), blockSize(4096), appended(false) {}
+    ~ReplayArchiveWriter() { close(); }
+
+    // Fails when path exists but holds no valid footer at all, or when it
+    // cannot be opened for writing.
+    bool open(const std::string& archivePath, size_t replaysPerBlock = 4096) {
+        close();
+        path = archivePath;
+        blockSize = replaysPerBlock > 0 ? replaysPerBlock : 1;
+        blocks.clear();
+        pending.clear();
+        writeOffset = 0;
+        nextId = 1;
+        appended = false;
+
+        std::ifstream existing(path.c_str(), std::ios::binary | std::ios::ate);
+        if (existing && existing.tellg() > 0) {
+            writeOffset = (uint64_t)existing.tellg();
+            if (replay_format::readIndex(existing, blocks) < 0) return false;
+            if (!blocks.empty()) {
+                nextId = blocks.back().lastId + 1;
+                const ReplayBlockInfo& last = blocks.back();
+                if (last.count < blockSize) {
+                    // The old copy stays on disk, still listed by the old
+                    // footer, until close() has written the new one. A block
+                    // that does not decode is kept as it is and not refilled.
+                    std::vector<uint8_t> header(replay_format::BLOCK_HEADER_SIZE);
+                    std::vector<uint8_t> data(last.size);
+                    existing.clear();
+                    existing.seekg((std::streamoff)last.offset);
+                    bool refill = existing.read((char*)header.data(), header.size()) &&
+                                  existing.read((char*)data.data(), data.size()) &&
+                                  replay_format::checkBlockHeader(header.data(), data) &&
+                                  replay_format::decodeBlock(data, pending) &&
+                                  pending.size() == last.count;
+                    if (refill) blocks.pop_back();
+                    else pending.clear();
+                }
+            }
+            existing.close();
+            file.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        } else {
+            existing.close();
+            file.open(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+            // An empty footer right away, so even a new archive is readable
+            // if the first close() never happens.
+            if (file.is_open()) writeFooter();
+        }
+        return file.is_open() && file.good();
+    }
+
+    // Stores r under the next game ID and returns that ID.
+    uint64_t append(const Replay& r) {
+        pending.push_back(r);
+        pending.back().id = nextId;
+        appended = true;
+        if (pending.size() >= blockSize) writeBlock();
+        return nextId++;
+    }
+
+    void close() {
+        if (!file.is_open()) return;
+        if (!appended) {
+            // Nothing new: the footer on disk already describes the archive.
+            file.close();
+            return;
+        }
+        writeBlock();
+        writeFooter();
+        bool written = file.good();
+        file.close();
+        if (written && writeOffset > 2 * liveBytes()) compact();
+    }
+};
+
+// Random access to a closed archive. Only the footer is read on open; each
+// query decompresses just the blocks whose index ranges can match.
+class ReplayArchiveReader {
+private:
+    std::string path;
+    std::vector<ReplayBlockInfo> blocks;
+
+    // Fails on a block whose header checksum or replay count does not match.
+    bool loadBlock(std::ifstream& file, size_t b, std::vector<Replay>& out) const {
+        uint8_t header[replay_format::BLOCK_HEADER_SIZE];
+        std::vector<uint8_t> data(blocks[b].size);
+        file.clear();
+        file.seekg((std::streamoff)blocks[b].offset);
+        if (!file.read((char*)header, sizeof(header))) return false;
+        if (!file.read((char*)data.data(), data.size())) return false;
+        if (!replay_format::checkBlockHeader(header, data)) return false;
+        return replay_format::decodeBlock(data, out) && out.size() == blocks[b].count;
+    }
+
+    template <class Keep>
+    size_t collect(Keep keep, std::vector<Replay>& out) const {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        std::vector<Replay> replays;
+        size_t decoded = 0;
+        for (size_t b = 0; b < blocks.size(); b++) {
+            if (!keep.block(blocks[b])) continue;
+            if (!loadBlock(file, b, replays)) continue;
+            decoded++;
+            for (size_t i = 0; i < replays.size(); i++) {
+                if (keep.replay(replays[i])) out.push_back(replays[i]);
+            }
+        }
+        return decoded;
+    }
+
+    struct ScoreRange {
+        int32_t lo, hi;
+        bool block(const ReplayBlockInfo& b) const { return b.maxScore >= lo && b.minScore <= hi; }
+        bool replay(const Replay& r) const { return r.score >= lo && r.score <= hi; }
+    };
+
+    struct DateRange {
+        int64_t from, to;
+        bool block(const ReplayBlockInfo& b) const { return b.maxDate >= from && b.minDate <= to; }
+        bool replay(const Replay& r) const { return r.date >= from && r.date <= to; }
+    };
+
+public:
+    bool open(const std::string& archivePath) {
+        path = archivePath;
+        std::ifstream file(path.c_str(), std::ios::binary);
+        return file && replay_format::readIndex(file, blocks) >= 0;
+    }
+
+    const std::vector<ReplayBlockInfo>& getBlocks() const { return blocks; }
+
+    uint64_t replayCount() const {
+        uint64_t n = 0;
+        for (size_t b = 0; b < blocks.size(); b++) n += blocks[b].count;
+        return n;
+    }
+
+    bool findById(uint64_t id, Replay& out) const {
+        size_t lo = 0, hi = blocks.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (blocks[mid].lastId < id) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == blocks.size() || blocks[lo].firstId > id) return false;
+
+        std::ifstream file(path.c_str(), std::ios::binary);
+        std::vector<Replay> replays;
+        if (!loadBlock(file, lo, replays)) return false;
+        for (size_t i = 0; i < replays.size(); i++) {
+            if (replays[i].id == id) {
+                out = replays[i];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Both return the number of blocks that had to be decompressed.
+    size_t findByScore(int32_t lo, int32_t hi, std::vector<Replay>& out) const {
+        ScoreRange range = { lo, hi };
+        return collect(range, out);
+    }
+
+    size_t findByDate(int64_t from, int64_t to, std::vector<Replay>& out) const {
+        DateRange range = { from, to };
+        return collect(range, out);
+    }
+
+    // Decodes every block, spreading blocks over threads, and calls
+    // fn(worker, replay) for each replay. fn runs concurrently on different
+    // workers, so per-worker state should be indexed by the worker number.
+    template <class Fn>
+    void forEachParallel(Fn& fn, int threads) const {
+        if (threads < 1) threads = 1;
+        std::vector<std::thread> workers;
+        for (int w = 0; w < threads; w++) {
+            workers.push_back(std::thread([this, &fn, w, threads] {
+                std::ifstream file(path.c_str(), std::ios::binary);
+                std::vector<Replay> replays;
+                for (size_t b = w; b < blocks.size(); b += threads) {
+                    if (!loadBlock(file, b, replays)) continue;
+                    for (size_t i = 0; i < replays.size(); i++) fn(w, replays[i]);
+                }
+            }));
+        }
+        for (size_t w = 0; w < workers.size(); w++) workers[w].join();
+    }
+};
+
+#endif
@@ -0,0 +1,214 @@
+#define SQUEEZER_BUILD
+#include "squeezer.h"
+#include "board.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+// Fixed set of worker threads. run() splits [0, n) into one contiguous chunk
+// per thread, with the calling thread taking the first chunk itself.
+class WorkerPool {
+private:
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    void (*task)(void*, int, int);
+    void* taskArg;
+    int taskSize;
+    int generation;
+    int pending;
+    bool stopping;
+
+    void chunk(int part, int& begin, int& end) const {
+        int parts = (int)threads.size() + 1;
+        begin = (int)((long long)taskSize * part / parts);
+        end = (int)((long long)taskSize * (part + 1) / parts);
+    }
+
+    void workerLoop(int part) {
+        int seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            int begin, end;
+            chunk(part, begin, end);
+            task(taskArg, begin, end);
+            std::lock_guard<std::mutex> guard(lock);
+            if (--pending == 0) finished.notify_one();
+        }
+    }
+
+    void stopAll() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    }
+
+public:
+    explicit WorkerPool(int workers) : task(0), taskArg(0), taskSize(0), generation(0),
+                                       pending(0), stopping(false) {
+        threads.reserve(workers);
+        try {
+            for (int i = 0; i < workers; i++) {
+                threads.push_back(std::thread(&WorkerPool::workerLoop, this, i + 1));
+            }
+        } catch (...) {
+            // Joinable threads must not be destroyed, so stop the ones started.
+            stopAll();
+            throw;
+        }
+    }
+
+    ~WorkerPool() { stopAll(); }
+
+    void run(void (*fn)(void*, int, int), void* arg, int n) {
+        // Waking the pool costs more than stepping a handful of boards.
+        if (threads.empty() || n < 64 * ((int)threads.size() + 1)) {
+            fn(arg, 0, n);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            task = fn;
+            taskArg = arg;
+            taskSize = n;
+            pending = (int)threads.size();
+            generation++;
+        }
+        wake.notify_all();
+        int begin, end;
+        chunk(0, begin, end);
+        fn(arg, begin, end);
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait(guard, [&] { return pending == 0; });
+    }
+};
+
+struct squeezer_batch {
+    std::vector<Board> envs;
+    squeezer_buffers out;
+    const int32_t* actions;
+    const uint8_t* resetMask;
+    WorkerPool* pool;
+};
+
+static void writeObservation(squeezer_batch* batch, int i) {
+    const Board& env = batch->envs[i];
+    int32_t* obs = batch->out.observations + (size_t)i * SQUEEZER_OBS_SIZE;
+    for (int r = 0; r < Board::SIZE; r++)
+        for (int c = 0; c < Board::SIZE; c++)
+            obs[r * Board::SIZE + c] = env.getCell(r, c);
+    obs[25] = env.getLauncherNumber();
+    obs[26] = env.getNextNumber();
+
+    uint8_t* mask = batch->out.legal_masks + (size_t)i * SQUEEZER_COLUMNS;
+    bool anyLegal = false;
+    for (int c = 0; c < SQUEEZER_COLUMNS; c++) {
+        mask[c] = env.canDrop(c) ? 1 : 0;
+        if (mask[c]) anyLegal = true;
+    }
+    // With every column blocked, any drop would end the game anyway.
+    if (!anyLegal || env.isGameOver()) batch->out.dones[i] = 1;
+}
+
+static void stepRange(void* arg, int begin, int end) {
+    squeezer_batch* batch = (squeezer_batch*)arg;
+    for (int i = begin; i < end; i++) {
+        if (batch->out.dones[i]) {
+            batch->out.rewards[i] = 0.0f;
+            continue;
+        }
+        Board& env = batch->envs[i];
+        int col = batch->actions[i];
+        int before = env.getScore();
+        bool ok = col >= 0 && col < SQUEEZER_COLUMNS && env.dropLauncher(col);
+        batch->out.rewards[i] = ok ? (float)(env.getScore() - before) : 0.0f;
+        batch->out.dones[i] = ok ? 0 : 1;
+        writeObservation(batch, i);
+    }
+}
+
+static void resetRange(void* arg, int begin, int end) {
+    squeezer_batch* batch = (squeezer_batch*)arg;
+    for (int i = begin; i < end; i++) {
+        if (batch->resetMask && !batch->resetMask[i]) continue;
+        batch->envs[i].resetGame();
+        batch->out.rewards[i] = 0.0f;
+        batch->out.dones[i] = 0;
+        writeObservation(batch, i);
+    }
+}
+
+static unsigned envSeed(uint32_t seed, int i) {
+    unsigned long long z = seed + 0x9E3779B97F4A7C15ULL * (unsigned long long)(i + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (unsigned)(z ^ (z >> 31));
+}
+
+squeezer_batch* squeezer_create(int num_envs, uint32_t seed, int num_threads,
+                                const squeezer_buffers* buffers) {
+    if (num_envs <= 0 || !buffers || !buffers->observations || !buffers->rewards ||
+        !buffers->dones || !buffers->legal_masks) {
+        return 0;
+    }
+    if (num_threads <= 0) {
+        num_threads = (int)std::thread::hardware_concurrency();
+        if (num_threads <= 0) num_threads = 1;
+    }
+
+    // Exceptions must not cross the C ABI: running out of memory or threads
+    // is reported as NULL like any other failure.
+    squeezer_batch* batch = 0;
+    try {
+        batch = new squeezer_batch();
+        batch->pool = 0;
+        batch->envs.resize(num_envs);
+        batch->out = *buffers;
+        batch->actions = 0;
+        batch->resetMask = 0;
+        for (int i = 0; i < num_envs; i++) {
+            batch->envs[i].seedRandom(envSeed(seed, i));
+        }
+        batch->pool = new WorkerPool(num_threads - 1);
+        batch->pool->run(resetRange, batch, num_envs);
+        return batch;
+    } catch (...) {
+        squeezer_destroy(batch);
+        return 0;
+    }
+}
+
+void squeezer_destroy(squeezer_batch* batch) {
+    if (!batch) return;
+    delete batch->pool;
+    delete batch;
+}
+
+int squeezer_num_envs(const squeezer_batch* batch) {
+    return batch ? (int)batch->envs.size() : 0;
+}
+
+void squeezer_step_batch(squeezer_batch* batch, const int32_t* actions) {
+    if (!batch || !actions) return;
+    batch->actions = actions;
+    batch->pool->run(stepRange, batch, (int)batch->envs.size());
+    batch->actions = 0;
+}
+
+void squeezer_reset_where(squeezer_batch* batch, const uint8_t* done_mask) {
+    if (!batch || !done_mask) return;
+    batch->resetMask = done_mask;
+    batch->pool->run(resetRange, batch, (int)batch->envs.size());
+    batch->resetMask = 0;
+}
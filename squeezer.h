@@ -0,0 +1,65 @@
+/*
+ * libsqueezer: plain C interface for stepping batches of Number Squeezer
+ * environments, e.g. from a reinforcement learning trainer.
+ *
+ * The caller owns every buffer. They are bound once at creation and the
+ * library writes observations, rewards, done flags and legal-move masks
+ * straight into them; stepping and resetting never allocate.
+ *
+ * Build (MinGW):  g++ -O2 -shared squeezer.cpp -o squeezer.dll
+ * Build (Linux):  g++ -O2 -shared -fPIC -pthread squeezer.cpp -o libsqueezer.so
+ */
+#ifndef SQUEEZER_H
+#define SQUEEZER_H
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(SQUEEZER_BUILD)
+#    define SQUEEZER_API __declspec(dllexport)
+#  else
+#    define SQUEEZER_API __declspec(dllimport)
+#  endif
+#else
+#  define SQUEEZER_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SQUEEZER_COLUMNS 5
+/* 25 board cells in row-major order, then the launcher and next numbers. */
+#define SQUEEZER_OBS_SIZE 27
+
+typedef struct squeezer_batch squeezer_batch;
+
+typedef struct squeezer_buffers {
+    int32_t* observations;   /* num_envs * SQUEEZER_OBS_SIZE */
+    float* rewards;          /* num_envs, score gained by the last step */
+    uint8_t* dones;          /* num_envs, 1 once the game has ended */
+    uint8_t* legal_masks;    /* num_envs * SQUEEZER_COLUMNS */
+} squeezer_buffers;
+
+/* Creates num_envs freshly reset environments. num_threads <= 0 picks the
+ * hardware concurrency. Returns NULL on bad arguments or when memory or
+ * threads cannot be allocated. */
+SQUEEZER_API squeezer_batch* squeezer_create(int num_envs, uint32_t seed, int num_threads,
+                                             const squeezer_buffers* buffers);
+
+SQUEEZER_API void squeezer_destroy(squeezer_batch* batch);
+
+SQUEEZER_API int squeezer_num_envs(const squeezer_batch* batch);
+
+/* Drops actions[i] (a column) in every environment that is not done.
+ * An illegal column ends that game, as it does in the console game. */
+SQUEEZER_API void squeezer_step_batch(squeezer_batch* batch, const int32_t* actions);
+
+/* Starts a new game in every environment whose done_mask entry is nonzero. */
+SQUEEZER_API void squeezer_reset_where(squeezer_batch* batch, const uint8_t* done_mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
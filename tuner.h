@@ -0,0 +1,204 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bot.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Evolution-strategy tuner for the bot weights, in the style of a diagonal
+// CMA-ES: each generation samples candidates around a mean with per-weight
+// step sizes, scores them by playing games, and moves the mean and step sizes
+// towards the best half.
+//
+// Every candidate in a generation plays the same game seeds. A bot never
+// consumes the tile RNG while looking ahead, so equal seeds mean equal
+// rollRandomTile sequences (common random numbers), and score differences
+// come from the weights rather than from luck. For the same reason the best
+// weights found so far are replayed on every generation's seeds, so best is
+// only ever compared against scores from the same games.
+class WeightTuner {
+public:
+    struct Candidate {
+        double weights[BOT_FEATURES];
+        double fitness;   // mean score over the generation's games
+    };
+
+private:
+    int population;
+    int gamesPerCandidate;
+    int threads;
+    int maxDrops;
+    int generation;
+    double mean[BOT_FEATURES];
+    double sigma[BOT_FEATURES];
+    Candidate best;
+    std::mt19937 rng;
+    std::vector<Candidate> lastGeneration;
+    double lastSeconds;
+    int lastEvaluated;
+
+    void evaluate(std::vector<Candidate>& candidates, const std::vector<uint32_t>& seeds) {
+        int games = (int)seeds.size();
+        int total = (int)candidates.size() * games;
+        std::vector<int> scores(total);
+        std::atomic<int> next(0);
+
+        std::vector<std::thread> workers;
+        for (int w = 0; w < threads; w++) {
+            workers.push_back(std::thread([&] {
+                for (int task = next++; task < total; task = next++) {
+                    const Candidate& c = candidates[task / games];
+                    scores[task] = playBotGame(c.weights, seeds[task % games], maxDrops);
+                }
+            }));
+        }
+        for (size_t w = 0; w < workers.size(); w++) workers[w].join();
+
+        for (size_t c = 0; c < candidates.size(); c++) {
+            long long sum = 0;
+            for (int g = 0; g < games; g++) sum += scores[c * games + g];
+            candidates[c].fitness = (double)sum / games;
+        }
+    }
+
+public:
+    WeightTuner(int populationSize, int games, int threadCount)
+        : population(populationSize < 4 ? 4 : populationSize),
+          gamesPerCandidate(games < 1 ? 1 : games),
+          threads(threadCount < 1 ? 1 : threadCount),
+          maxDrops(2000), generation(0), rng(20240611u), lastSeconds(0), lastEvaluated(0) {
+        for (int k = 0; k < BOT_FEATURES; k++) {
+            mean[k] = 0.0;
+            sigma[k] = 8.0;
+            best.weights[k] = 0.0;
+        }
+        best.fitness = -1.0;
+    }
+
+    int getGeneration() const { return generation; }
+    const double* getMean() const { return mean; }
+    const double* getSigma() const { return sigma; }
+    const Candidate& getBest() const { return best; }
+    const std::vector<Candidate>& getLastGeneration() const { return lastGeneration; }
+
+    int candidatesPerGeneration() const { return population; }
+    double lastGenerationSeconds() const { return lastSeconds; }
+    // What the last generation played, counting the incumbent as one more
+    // candidate; lastGenerationSeconds() timed all of it.
+    int lastGenerationCandidates() const { return lastEvaluated; }
+    int lastGenerationGames() const { return lastEvaluated * gamesPerCandidate; }
+
+    void runGeneration() {
+        std::normal_distribution<double> gauss(0.0, 1.0);
+        std::vector<Candidate> candidates(population);
+        // The current mean always competes, so a good mean is never lost.
+        for (int k = 0; k < BOT_FEATURES; k++) candidates[0].weights[k] = mean[k];
+        for (int c = 1; c < population; c++) {
+            for (int k = 0; k < BOT_FEATURES; k++) {
+                candidates[c].weights[k] = mean[k] + sigma[k] * gauss(rng);
+            }
+        }
+        // The incumbent plays along as an extra entry, outside the ranking.
+        bool haveBest = best.fitness >= 0;
+        if (haveBest) candidates.push_back(best);
+        std::vector<uint32_t> seeds(gamesPerCandidate);
+        for (int g = 0; g < gamesPerCandidate; g++) seeds[g] = (uint32_t)rng();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        evaluate(candidates, seeds);
+        lastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        lastEvaluated = (int)candidates.size();
+        if (haveBest) {
+            best = candidates.back();
+            candidates.pop_back();
+        }
+
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Candidate& a, const Candidate& b) { return a.fitness > b.fitness; });
+
+        // Log-rank weights over the best half, as in CMA-ES recombination.
+        int mu = population / 2;
+        std::vector<double> w(mu);
+        double wSum = 0;
+        for (int i = 0; i < mu; i++) {
+            w[i] = std::log(mu + 0.5) - std::log(i + 1.0);
+            wSum += w[i];
+        }
+        for (int k = 0; k < BOT_FEATURES; k++) {
+            double newMean = 0, spread = 0;
+            for (int i = 0; i < mu; i++) newMean += w[i] / wSum * candidates[i].weights[k];
+            for (int i = 0; i < mu; i++) {
+                double d = candidates[i].weights[k] - mean[k];
+                spread += w[i] / wSum * d * d;
+            }
+            mean[k] = newMean;
+            sigma[k] = 0.7 * sigma[k] + 0.3 * std::sqrt(spread);
+            if (sigma[k] < 0.05) sigma[k] = 0.05;
+        }
+
+        if (candidates[0].fitness > best.fitness) best = candidates[0];
+        lastGeneration = candidates;
+        generation++;
+    }
+
+    // Plain-text checkpoint written between generations. It goes to a
+    // temporary file first so an interrupted write keeps the old one.
+    bool saveCheckpoint(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp.c_str());
+            if (!out) return false;
+            out.precision(17);
+            out << "generation " << generation << "\n";
+            out << "mean";
+            for (int k = 0; k < BOT_FEATURES; k++) out << " " << mean[k];
+            out << "\nsigma";
+            for (int k = 0; k < BOT_FEATURES; k++) out << " " << sigma[k];
+            out << "\nbest " << best.fitness;
+            for (int k = 0; k < BOT_FEATURES; k++) out << " " << best.weights[k];
+            out << "\nrng " << rng << "\n";
+            if (!out) return false;
+        }
+        // Replaces the old file in one step, so there is never a moment
+        // without a checkpoint.
+#ifdef _WIN32
+        return MoveFileExA(tmp.c_str(), path.c_str(),
+                           MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        return rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+    }
+
+    bool loadCheckpoint(const std::string& path) {
+        std::ifstream in(path.c_str());
+        if (!in) return false;
+        std::string label;
+        WeightTuner restored = *this;
+        in >> label >> restored.generation;
+        in >> label;
+        for (int k = 0; k < BOT_FEATURES; k++) in >> restored.mean[k];
+        in >> label;
+        for (int k = 0; k < BOT_FEATURES; k++) in >> restored.sigma[k];
+        in >> label >> restored.best.fitness;
+        for (int k = 0; k < BOT_FEATURES; k++) in >> restored.best.weights[k];
+        in >> label >> restored.rng;
+        if (!in) return false;
+        *this = restored;
+        return true;
+    }
+};
+
+#endif